@@ -0,0 +1,163 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2024. Muhammad Raznan. All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Runs the free chunk of a condition heavy rule in a loop, the result is
+// the cost of bytecode dispatch without SQLite in the way.
+
+#include "ast.h"
+#include "compiler.h"
+#include "error.h"
+#include "exec.h"
+#include "parser.h"
+#include "token.h"
+
+#include "jary/defs.h"
+#include "jary/memory.h"
+#include "jary/types.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef JRY_SWITCH_DISPATCH
+#define DISPATCH "switch"
+#else
+#define DISPATCH "threaded"
+#endif
+
+static const char src[] = "ingress data {\n"
+			  "  field:\n"
+			  "    a long\n"
+			  "    b long\n"
+			  "}\n"
+			  "rule bench {\n"
+			  "  match:\n"
+			  "    $data.a equal 1\n"
+			  "  condition:\n"
+			  "    $data.a * 3 + $data.b > 10 and"
+			  "    $data.b - $data.a < 100\n"
+			  "    $data.a + $data.b * $data.b > $data.a or"
+			  "    1 == 2\n"
+			  "    not ($data.a * $data.a + 1 < $data.b - 40)\n"
+			  "    $data.a > 3 and $data.b < 100 and"
+			  "    $data.a == 7 or $data.a * $data.b < 0\n"
+			  "  output:\n"
+			  "    $data.a + $data.b * 2\n"
+			  "}\n";
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(int argc, const char **argv)
+{
+	int		ret   = 1;
+	long		iter  = argc > 1 ? strtol(argv[1], NULL, 10) : 5000000;
+	struct jy_asts	asts  = { .tkns = NULL };
+	struct jy_tkns	tkns  = { .lexemes = NULL };
+	struct tkn_errs errs  = { .from = NULL };
+	struct jy_jay	jay   = { .codes = NULL };
+	struct sc_mem	alloc = { .buf = NULL };
+	struct sb_mem	bump  = { .buf = NULL };
+
+	jry_parse(&alloc, &asts, &tkns, &errs, src, sizeof(src) - 1);
+
+	if (errs.size)
+		goto FINISH;
+
+	jry_compile(&alloc, &jay, &errs, "", &asts, &tkns);
+
+	if (errs.size)
+		goto FINISH;
+
+	union jy_value event;
+
+	if (def_get(jay.names, "data", &event, NULL))
+		goto FINISH;
+
+	def_set(event.def, "a", (union jy_value) { .i64 = 7 }, JY_K_LONG);
+	def_set(event.def, "b", (union jy_value) { .i64 = 42 }, JY_K_LONG);
+
+	size_t		stacksz = sizeof(union jy_value) * (jay.stackmax + 1);
+	union jy_value *stack	= sc_alloc(&alloc, stacksz);
+
+	if (stack == NULL)
+		goto FINISH;
+
+	const uint8_t  *chunk = jay.fcodes + jay.rulefofs[0];
+	struct jy_state state = {
+		.lifetime = &alloc,
+		.outm	  = &bump,
+		.stack	  = stack,
+	};
+
+	double best = 0;
+
+	// best of a few rounds to keep scheduler noise out
+	for (int round = 0; round < 5; ++round) {
+		double start = now();
+
+		for (long i = 0; i < iter; ++i) {
+			state.outsz = 0;
+			bump.size   = 0;
+
+			if (jry_exec(NULL, &jay, chunk, &state))
+				goto FINISH;
+		}
+
+		double elapsed = now() - start;
+
+		if (round == 0 || elapsed < best)
+			best = elapsed;
+	}
+
+	if (state.outsz != 1 || state.out[0].i64 != 91)
+		goto FINISH;
+
+	printf("%-8s %ld runs %8.2f ns/run\n", DISPATCH, iter, best / iter);
+
+	ret = 0;
+
+FINISH:
+	if (ret)
+		fprintf(stderr, "benchmark failed\n");
+
+	sc_free(&alloc);
+	sb_free(&bump);
+
+	return ret;
+}
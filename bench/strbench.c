@@ -0,0 +1,209 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2024. Muhammad Raznan. All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Runs a rule over a table of low cardinality strings with and without
+// the intern table, the difference is the cost of copying every string
+// of every row.
+
+#include "ast.h"
+#include "compiler.h"
+#include "error.h"
+#include "exec.h"
+#include "parser.h"
+#include "token.h"
+
+#include "jary/memory.h"
+#include "jary/types.h"
+
+#include <sqlite3.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define ROWS 10000
+
+static const char src[] = "ingress http {\n"
+			  "  field:\n"
+			  "    method string\n"
+			  "    result string\n"
+			  "    country string\n"
+			  "}\n"
+			  "rule bench {\n"
+			  "  match:\n"
+			  "    $http.method exact \"GET\"\n"
+			  "  output:\n"
+			  "    $http.method\n"
+			  "    $http.result\n"
+			  "    $http.country\n"
+			  "}\n";
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int fill(struct sqlite3 *db)
+{
+	static const char *methods[]   = { "GET", "POST", "PUT" };
+	static const char *results[]   = { "allowed", "denied" };
+	static const char *countries[] = { "ID", "MY", "SG", "US", "JP" };
+
+	struct sqlite3_stmt *stmt = NULL;
+
+	const char sql[] = "INSERT INTO http (method, result, country)"
+			   " VALUES (?, ?, ?);";
+
+	if (sqlite3_exec(db,
+			 "CREATE TABLE http (method TEXT, result TEXT,"
+			 " country TEXT);"
+			 "BEGIN;",
+			 NULL, NULL, NULL)
+	    != SQLITE_OK)
+		return 1;
+
+	if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+		return 1;
+
+	for (int i = 0; i < ROWS; ++i) {
+		sqlite3_bind_text(stmt, 1, methods[i % 3], -1, SQLITE_STATIC);
+		sqlite3_bind_text(stmt, 2, results[i % 2], -1, SQLITE_STATIC);
+		sqlite3_bind_text(stmt, 3, countries[i % 5], -1,
+				  SQLITE_STATIC);
+
+		if (sqlite3_step(stmt) != SQLITE_DONE)
+			break;
+
+		sqlite3_reset(stmt);
+	}
+
+	sqlite3_finalize(stmt);
+
+	return sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL) != SQLITE_OK;
+}
+
+// best of a few rounds to keep scheduler noise out
+static double run(struct sqlite3	 *db,
+		  struct jy_jay		 *jay,
+		  struct jy_intern	 *strs,
+		  long			  iter,
+		  uint32_t		 *outsz)
+{
+	double best = -1;
+
+	for (int round = 0; round < 5; ++round) {
+		double start = now();
+
+		for (long i = 0; i < iter; ++i) {
+			struct sc_mem	sc    = { .buf = NULL };
+			struct sb_mem	out   = { .buf = NULL };
+			struct jy_state state = {
+				.lifetime = &sc,
+				.outm	  = &out,
+				.strs	  = strs,
+			};
+
+			int ret = jry_exec(db, jay, jay->codes, &state);
+
+			*outsz = state.outsz;
+
+			sb_free(&out);
+			sc_free(&sc);
+
+			if (ret)
+				return -1;
+		}
+
+		double elapsed = now() - start;
+
+		if (round == 0 || elapsed < best)
+			best = elapsed;
+	}
+
+	return best;
+}
+
+int main(int argc, const char **argv)
+{
+	int		 ret   = 1;
+	long		 iter  = argc > 1 ? strtol(argv[1], NULL, 10) : 50;
+	struct jy_asts	 asts  = { .tkns = NULL };
+	struct jy_tkns	 tkns  = { .lexemes = NULL };
+	struct tkn_errs	 errs  = { .from = NULL };
+	struct jy_jay	 jay   = { .codes = NULL };
+	struct sc_mem	 alloc = { .buf = NULL };
+	struct jy_intern strs  = { .arena = NULL };
+	struct sqlite3	*db    = NULL;
+	uint32_t	 outsz = 0;
+
+	jry_parse(&alloc, &asts, &tkns, &errs, src, sizeof(src) - 1);
+
+	if (errs.size)
+		goto FINISH;
+
+	jry_compile(&alloc, &jay, &errs, "", &asts, &tkns);
+
+	if (errs.size)
+		goto FINISH;
+
+	if (sqlite3_open(":memory:", &db) != SQLITE_OK || fill(db))
+		goto FINISH;
+
+	double copied = run(db, &jay, NULL, iter, &outsz);
+
+	jry_intern_pool(&strs, &jay);
+
+	double interned = run(db, &jay, &strs, iter, &outsz);
+
+	if (copied < 0 || interned < 0 || outsz != (ROWS + 2) / 3 * 3)
+		goto FINISH;
+
+	printf("copied   %ld runs %10.2f ns/row\n", iter,
+	       copied / iter / ROWS);
+	printf("interned %ld runs %10.2f ns/row\n", iter,
+	       interned / iter / ROWS);
+
+	ret = 0;
+
+FINISH:
+	if (ret)
+		fprintf(stderr, "benchmark failed\n");
+
+	sqlite3_close(db);
+	sc_free(&alloc);
+	jry_intern_free(&strs);
+
+	return ret;
+}
@@ -41,20 +41,75 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define JARY_ERR_SQLITE3  0x20
 #define JARY_ERR_NOTEXIST 0x21
 #define JARY_ERR_MISMATCH 0x22
+// some rule ran out of budget, see jary_rule_limit()
+#define JARY_ERR_LIMIT	  0x23
+#define JARY_ERR_INTR	  0x24
 #define JARY_INT_CRASH	  0x101
 #define JARY_INT_FINAL	  0x102
 
+#define JARY_SINK_NDJSON 0x1
+// sink options, or'ed with the format
+#define JARY_SINK_RULE	 0x100
+#define JARY_SINK_TIME	 0x200
+
 #ifndef JARY_API
 #	define JARY_API
 #endif
 
 struct jary;
 struct jyOutput;
+struct jyBatch;
 struct sqlite3;
 
+// counters of a rule since the code was compiled, times are nanoseconds
+// and only counted while profiling, see jary_profile()
+struct jyRuleStats {
+	const char   *name;
+	unsigned long runs;
+	// rows returned by the rule query, and rows output out of them
+	unsigned long rows;
+	unsigned long matches;
+	// bytecode instructions run, native rules have none
+	unsigned long ops;
+	// executions stopped by the rule budget
+	unsigned long limits;
+	unsigned long prepare_ns;
+	unsigned long step_ns;
+	unsigned long interpret_ns;
+	unsigned long callback_ns;
+};
+
+struct jyIngressStats {
+	const char   *name;
+	unsigned long events;
+};
+
+// nanoseconds from jary_event() to a match of the event reaching its
+// callbacks, each value is the upper bound of its histogram bucket
+struct jyLatency {
+	unsigned long count;
+	unsigned long p50;
+	unsigned long p99;
+	unsigned long p999;
+	unsigned long max;
+};
+
+struct jyStats {
+	unsigned long		     executions;
+	// time spent inserting the queued events
+	unsigned long		     insert_ns;
+	const struct jyIngressStats *ingress;
+	const struct jyRuleStats    *rules;
+	unsigned int		     ingressz;
+	unsigned int		     rulesz;
+};
+
 JARY_API int jary_open(struct jary **);
 JARY_API int jary_close(struct jary *);
 JARY_API int jary_modulepath(struct jary *, const char *path);
+JARY_API int jary_storage(struct jary *,
+			  const char   *path,
+			  unsigned long window);
 JARY_API int jary_event(struct jary *, const char *name, unsigned int *event);
 
 JARY_API int jary_field_str(struct jary *,
@@ -82,12 +137,68 @@ JARY_API int jary_rule_clbk(struct jary *jary,
 			    int (*callback)(void *, const struct jyOutput *),
 			    void *data);
 
+JARY_API int jary_rule_stream(struct jary *jary,
+			      const char  *name,
+			      int (*callback)(void *, const struct jyOutput *),
+			      void *data);
+
+JARY_API int jary_rule_batch_clbk(struct jary *jary,
+				  const char  *name,
+				  unsigned int rows,
+				  int (*clbk)(void *, const struct jyBatch *),
+				  void *data);
+
+JARY_API int jary_rule_sink(struct jary *jary,
+			    const char	*name,
+			    int		 fd,
+			    unsigned int flags);
+
+JARY_API int jary_ring(struct jary *jary,
+		       unsigned int slots,
+		       unsigned int slotsize);
+JARY_API int jary_rule_ring(struct jary *jary, const char *name);
+JARY_API int jary_poll_matches(struct jary *jary,
+			       unsigned int max,
+			       int (*clbk)(void *,
+					   const char *rule,
+					   const struct jyOutput *),
+			       void	    *data,
+			       unsigned int *polled);
+JARY_API void jary_ring_overflow(struct jary *jary, unsigned long *count);
+
+JARY_API int jary_rule_limit(struct jary  *jary,
+			     const char	  *name,
+			     unsigned long ops,
+			     unsigned long rows,
+			     unsigned long msec);
+JARY_API void jary_interrupt(struct jary *jary);
+
+JARY_API void jary_profile(struct jary *jary, unsigned char enable);
+JARY_API int  jary_stats(struct jary *jary, struct jyStats *stats);
+JARY_API int  jary_latency(struct jary *jary, unsigned char enable);
+JARY_API int  jary_latency_histogram(struct jary	   *jary,
+				     const char	   *name,
+				     struct jyLatency *latency);
+
+JARY_API int jary_rule_unclbk(struct jary *jary,
+			      const char  *name,
+			      int (*callback)(void *, const struct jyOutput *),
+			      void *data);
+
+JARY_API int jary_rule_batch_unclbk(struct jary *jary,
+				    const char	*name,
+				    int (*clbk)(void *, const struct jyBatch *),
+				    void *data);
+
 JARY_API int jary_compile_file(struct jary *, const char *path, char **errmsg);
 JARY_API int jary_compile(struct jary *,
 			  unsigned int size,
 			  const char  *source,
 			  char	     **errmsg);
 JARY_API int jary_execute(struct jary *);
+JARY_API int jary_rule_plan(struct jary *, const char *name, char **text);
+JARY_API int jary_native_source(struct jary *, char **text);
+JARY_API int jary_native(struct jary *, const char *path);
 
 JARY_API void jary_output_len(const struct jyOutput *output,
 			      unsigned int	    *length);
@@ -104,6 +215,21 @@ JARY_API int  jary_output_bool(const struct jyOutput *,
 			       unsigned int   index,
 			       unsigned char *truthy);
 
+JARY_API void jary_batch_len(const struct jyBatch *batch, unsigned int *rows);
+JARY_API int  jary_batch_str(const struct jyBatch *batch,
+			     unsigned int	  column,
+			     const char *const	**strs,
+			     const unsigned int **lens);
+JARY_API int  jary_batch_long(const struct jyBatch *batch,
+			      unsigned int	    column,
+			      const long	  **values);
+JARY_API int  jary_batch_ulong(const struct jyBatch  *batch,
+			       unsigned int	     column,
+			       const unsigned long **values);
+JARY_API int  jary_batch_bool(const struct jyBatch  *batch,
+			      unsigned int	     column,
+			      const unsigned char **values);
+
 JARY_API const char *jary_errmsg(struct jary *);
 
 JARY_API void jary_free(void *);
@@ -88,6 +88,16 @@ struct su_mem {
 	int size;
 };
 
+// bump allocator, sa_reset() keeps the blocks for the next round
+struct sa_mem {
+	struct sa_blk {
+		struct sa_blk *next;
+		uint32_t       size;
+		uint32_t       used;
+		char	       mem[];
+	} *head, *cur;
+};
+
 static inline void ifree(void **ptr)
 {
 	free(*ptr);
@@ -105,6 +115,10 @@ void  sb_free(struct sb_mem *sb);
 void *su_alloc(struct su_mem *alloc, void *scptr, uint32_t nmemb);
 void  su_free(struct su_mem *alloc);
 
+void *sa_alloc(struct sa_mem *alloc, uint32_t nmemb);
+void  sa_reset(struct sa_mem *alloc);
+void  sa_free(struct sa_mem *alloc);
+
 void *sc_alloc(struct sc_mem *alloc, uint32_t nmemb);
 void *sc_allocf(struct sc_mem *alloc, uint32_t nmemb, free_t expire);
 int   sc_strfmt(struct sc_mem *alloc, char **str, const char *fmt, ...);
@@ -0,0 +1,70 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2024. Muhammad Raznan. All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef JAYVM_NATIVE_H
+#define JAYVM_NATIVE_H
+
+// Interface between the runtime and a ruleset compiled to native code,
+// see jary_native_source() and jary_native().
+
+#include "jary/defs.h"
+#include "jary/types.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+// bumped whenever the structures below change
+#define JY_NATIVE_ABI 4
+
+struct jy_native {
+	// hand over the n values of a matched row, see OUTPUT
+	int (*output)(const struct jy_native *,
+		      const union jy_value *,
+		      uint32_t);
+	// concatenate n strings into the output memory
+	struct jy_str *(*concat)(struct jy_state *,
+				 const union jy_value *,
+				 uint32_t);
+	// handed to module functions
+	struct jy_state *state;
+	// registers set by the rule prologue before the first row
+	const union jy_value *regs;
+	// output types of the rule
+	const enum jy_ktype  *otypes;
+};
+
+// free chunk of a rule, runs once per matched row with the fields already
+// in the event definitions. A nonzero return stops the query.
+typedef int(jy_native_rule)(const union jy_value *vals,
+			    const struct jy_native *rt);
+
+#endif // JAYVM_NATIVE_H
@@ -50,6 +50,7 @@ enum jy_ast {
 	AST_CONDITION_SECT,
 	AST_OUTPUT_SECT,
 	AST_FIELD_SECT,
+	AST_SUPPRESS_SECT,
 
 	AST_LONG_TYPE,
 	AST_STR_TYPE,
@@ -42,7 +42,9 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "jary/types.h"
 
 #include <assert.h>
+#include <limits.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -63,6 +65,25 @@ struct compiler {
 	enum jy_ktype  **types;
 	uint32_t	*codesz;
 	uint16_t	*valsz;
+	// event fields loaded by the chunk, NULL when not tracked
+	struct jy_desc **reads;
+	uint32_t	*readsz;
+	// start of the current rule within reads
+	uint32_t	 readofs;
+	// output expressions already on the stack, in slot order
+	const uint32_t	    *outs;
+	const enum jy_ktype *outts;
+	uint32_t	     outsz;
+	// prologue chunk, NULL when nothing may be hoisted
+	uint8_t	     **pcodes;
+	uint32_t      *pcodesz;
+	// expressions hoisted so far, the index is the register
+	uint32_t      *hoists;
+	enum jy_ktype *hoistts;
+	uint32_t       hoistsz;
+	// optimizer counters, see jy_jay
+	uint32_t *foldsz;
+	uint32_t *sharesz;
 };
 
 static inline bool _expr(const struct jy_asts *asts,
@@ -109,7 +130,7 @@ static inline int emit_push(uint32_t constant, uint8_t **code, uint32_t *codesz)
 		if (emit_byte(constant & 0x00FF, code, codesz))
 			goto OUT_OF_MEMORY;
 
-		if (emit_byte(constant & 0xFF00, code, codesz))
+		if (emit_byte(constant >> 8, code, codesz))
 			goto OUT_OF_MEMORY;
 	}
 
@@ -218,17 +239,12 @@ PANIC:
 	return true;
 }
 
-static inline bool _long_expr(const struct jy_asts *asts,
-			      const struct jy_tkns *tkns,
-			      uint32_t		    id,
-			      struct compiler	   *ctx,
-			      struct tkn_errs	   *__unused(errs),
-			      struct expr	   *expr)
+// push the long constant, shared with every other use of the same value
+static inline bool emit_long(struct compiler *ctx,
+			     long	      value,
+			     struct expr     *expr)
 {
-	uint32_t tkn	= asts->tkns[id];
-	char	*lexeme = tkns->lexemes[tkn];
-
-	union jy_value num = { .i64 = strtol(lexeme, NULL, 10) };
+	union jy_value num = { .i64 = value };
 	expr->type	   = JY_K_LONG;
 
 	size_t		valsz = *ctx->valsz;
@@ -262,23 +278,12 @@ PANIC:
 	return true;
 }
 
-static inline bool _string_expr(const struct jy_asts *asts,
-				const struct jy_tkns *tkns,
-				uint32_t	      id,
-				struct compiler	     *ctx,
-				struct tkn_errs	     *__unused(errs),
-				struct expr	     *expr)
+// push the string constant, shared with every other use of the same value
+static inline bool emit_str(struct compiler *ctx,
+			    const char	    *cstr,
+			    uint32_t	     cstrsz,
+			    struct expr	    *expr)
 {
-	uint32_t tkn	= asts->tkns[id];
-	char	*lexeme = tkns->lexemes[tkn];
-	uint32_t lexsz	= tkns->lexsz[tkn];
-
-	// -2 to not inlucde ""
-	uint32_t cstrsz = lexsz - 2;
-	char	*cstr	= jry_alloc(cstrsz);
-
-	memcpy(cstr, lexeme + 1, cstrsz);
-
 	size_t		valsz = *ctx->valsz;
 	union jy_value *vals  = *ctx->vals;
 	enum jy_ktype  *types = *ctx->types;
@@ -314,14 +319,263 @@ EMIT:
 		goto PANIC;
 
 	expr->type = JY_K_STR;
-	jry_free(cstr);
 
 	return false;
 PANIC:
-	jry_free(cstr);
 	return true;
 }
 
+static inline bool _long_expr(const struct jy_asts *asts,
+			      const struct jy_tkns *tkns,
+			      uint32_t		    id,
+			      struct compiler	   *ctx,
+			      struct tkn_errs	   *__unused(errs),
+			      struct expr	   *expr)
+{
+	uint32_t tkn	= asts->tkns[id];
+	char	*lexeme = tkns->lexemes[tkn];
+
+	return emit_long(ctx, strtol(lexeme, NULL, 10), expr);
+}
+
+static inline bool _string_expr(const struct jy_asts *asts,
+				const struct jy_tkns *tkns,
+				uint32_t	      id,
+				struct compiler	     *ctx,
+				struct tkn_errs	     *__unused(errs),
+				struct expr	     *expr)
+{
+	uint32_t tkn	= asts->tkns[id];
+	char	*lexeme = tkns->lexemes[tkn];
+	uint32_t lexsz	= tkns->lexsz[tkn];
+
+	// +1 and -2 to not inlucde ""
+	return emit_str(ctx, lexeme + 1, lexsz - 2, expr);
+}
+
+// true when no call hides in the expression, calls may have side effects
+static bool _pure(const struct jy_asts *asts, uint32_t id)
+{
+	if (asts->types[id] == AST_CALL)
+		return false;
+
+	for (uint32_t i = 0; i < asts->childsz[id]; ++i)
+		if (!_pure(asts, asts->child[id][i]))
+			return false;
+
+	return true;
+}
+
+// true when both expressions are spelled the same
+static bool _same(const struct jy_asts *asts,
+		  const struct jy_tkns *tkns,
+		  uint32_t		a,
+		  uint32_t		b)
+{
+	if (asts->types[a] != asts->types[b])
+		return false;
+
+	if (asts->childsz[a] != asts->childsz[b])
+		return false;
+
+	if (asts->childsz[a] == 0) {
+		uint32_t ta = asts->tkns[a];
+		uint32_t tb = asts->tkns[b];
+
+		if (tkns->lexsz[ta] != tkns->lexsz[tb])
+			return false;
+
+		return !memcmp(tkns->lexemes[ta], tkns->lexemes[tb],
+			       tkns->lexsz[ta]);
+	}
+
+	for (uint32_t i = 0; i < asts->childsz[a]; ++i)
+		if (!_same(asts, tkns, asts->child[a][i], asts->child[b][i]))
+			return false;
+
+	return true;
+}
+
+// value of an arithmetic expression over literals only
+static bool _static_long(const struct jy_asts *asts,
+			 const struct jy_tkns *tkns,
+			 uint32_t	       id,
+			 long		      *value)
+{
+	uint32_t *child = asts->child[id];
+	long	  l;
+	long	  r;
+
+	switch (asts->types[id]) {
+	case AST_LONG:
+		*value = strtol(tkns->lexemes[asts->tkns[id]], NULL, 10);
+		return true;
+	case AST_ADDITION:
+	case AST_SUBTRACT:
+	case AST_MULTIPLY:
+	case AST_DIVIDE:
+		break;
+	default:
+		return false;
+	}
+
+	if (!_static_long(asts, tkns, child[0], &l)
+	    || !_static_long(asts, tkns, child[1], &r))
+		return false;
+
+	// wraps around like the interpreter, traps are left to the runtime
+	switch (asts->types[id]) {
+	case AST_ADDITION:
+		*value = (long) ((unsigned long) l + (unsigned long) r);
+		break;
+	case AST_SUBTRACT:
+		*value = (long) ((unsigned long) l - (unsigned long) r);
+		break;
+	case AST_MULTIPLY:
+		*value = (long) ((unsigned long) l * (unsigned long) r);
+		break;
+	default:
+		if (r == 0 || (l == LONG_MIN && r == -1))
+			return false;
+
+		*value = l / r;
+		break;
+	}
+
+	return true;
+}
+
+// Length of a concatenation over literals only, -1 if it is not. The
+// bytes are written to buf unless it is NULL.
+static int _static_str(const struct jy_asts *asts,
+		       const struct jy_tkns *tkns,
+		       uint32_t		     id,
+		       char		    *buf)
+{
+	uint32_t *child = asts->child[id];
+	uint32_t  tkn	= asts->tkns[id];
+
+	switch (asts->types[id]) {
+	case AST_STRING:
+		// skip the quotes
+		if (buf != NULL)
+			memcpy(buf, tkns->lexemes[tkn] + 1,
+			       tkns->lexsz[tkn] - 2);
+
+		return tkns->lexsz[tkn] - 2;
+	case AST_CONCAT:
+		break;
+	default:
+		return -1;
+	}
+
+	int l = _static_str(asts, tkns, child[0], buf);
+
+	if (l < 0)
+		return -1;
+
+	int r = _static_str(asts, tkns, child[1], buf ? buf + l : NULL);
+
+	return r < 0 ? -1 : l + r;
+}
+
+static int _static_eq(const struct jy_asts *asts,
+		      const struct jy_tkns *tkns,
+		      uint32_t		    left,
+		      uint32_t		    right);
+
+// 1 or 0 when the predicate is always true or false, -1 if the row decides
+static int _static_bool(const struct jy_asts *asts,
+			const struct jy_tkns *tkns,
+			uint32_t	      id)
+{
+	uint32_t *child = asts->child[id];
+	long	  x;
+	long	  y;
+	int	  l;
+	int	  r;
+
+	switch (asts->types[id]) {
+	case AST_TRUE:
+		return 1;
+	case AST_FALSE:
+		return 0;
+	case AST_NOT:
+		l = _static_bool(asts, tkns, child[0]);
+		return l < 0 ? -1 : !l;
+	case AST_AND:
+		l = _static_bool(asts, tkns, child[0]);
+		r = _static_bool(asts, tkns, child[1]);
+
+		if (l >= 0)
+			return l ? r : 0;
+
+		return (r == 0 && _pure(asts, child[0])) ? 0 : -1;
+	case AST_OR:
+		l = _static_bool(asts, tkns, child[0]);
+		r = _static_bool(asts, tkns, child[1]);
+
+		if (l >= 0)
+			return l ? 1 : r;
+
+		return (r == 1 && _pure(asts, child[0])) ? 1 : -1;
+	case AST_EQUALITY:
+		return _static_eq(asts, tkns, child[0], child[1]);
+	case AST_LESSER:
+	case AST_GREATER:
+		if (!_static_long(asts, tkns, child[0], &x)
+		    || !_static_long(asts, tkns, child[1], &y))
+			return -1;
+
+		return asts->types[id] == AST_LESSER ? x < y : x > y;
+	default:
+		return -1;
+	}
+}
+
+static int _static_eq(const struct jy_asts *asts,
+		      const struct jy_tkns *tkns,
+		      uint32_t		    left,
+		      uint32_t		    right)
+{
+	long x;
+	long y;
+
+	if (_static_long(asts, tkns, left, &x)
+	    && _static_long(asts, tkns, right, &y))
+		return x == y;
+
+	int l = _static_bool(asts, tkns, left);
+	int r = _static_bool(asts, tkns, right);
+
+	if (l >= 0 && r >= 0)
+		return l == r;
+
+	int lsz = _static_str(asts, tkns, left, NULL);
+	int rsz = _static_str(asts, tkns, right, NULL);
+
+	if (lsz < 0 || rsz < 0)
+		return -1;
+
+	if (lsz != rsz)
+		return 0;
+
+	int   ret = -1;
+	char *lbuf = jry_alloc(lsz + 1);
+	char *rbuf = jry_alloc(rsz + 1);
+
+	if (lbuf != NULL && rbuf != NULL) {
+		_static_str(asts, tkns, left, lbuf);
+		_static_str(asts, tkns, right, rbuf);
+		ret = !memcmp(lbuf, rbuf, lsz);
+	}
+
+	jry_free(lbuf);
+	jry_free(rbuf);
+
+	return ret;
+}
+
 static bool _descriptor_expr(const struct jy_asts *asts,
 			     const struct jy_tkns *tkns,
 			     uint32_t		   id,
@@ -438,6 +692,30 @@ static bool _eaccess_expr(const struct jy_asts *asts,
 	if (emit_byte(JY_OP_LOAD, ctx->codes, ctx->codesz))
 		return true;
 
+	if (ctx->reads == NULL)
+		return false;
+
+	struct jy_desc desc = (*ctx->vals)[expr->id].dscptr;
+
+	if ((*ctx->types)[desc.name] != JY_K_EVENT)
+		return false;
+
+	struct jy_desc *reads = *ctx->reads;
+
+	for (uint32_t i = ctx->readofs; i < *ctx->readsz; ++i) {
+		struct jy_desc d = reads[i];
+
+		if (d.name == desc.name && d.member == desc.member)
+			return false;
+	}
+
+	jry_mem_push(*ctx->reads, *ctx->readsz, desc);
+
+	if (*ctx->reads == NULL)
+		return true;
+
+	*ctx->readsz += 1;
+
 	return false;
 }
 
@@ -497,7 +775,20 @@ static bool _call_expr(const struct jy_asts *asts,
 		}
 	}
 
-	if (emit_byte(JY_OP_CALL, ctx->codes, ctx->codesz) != 0)
+	enum jy_opcode call;
+
+	switch (ofunc->return_type) {
+	case JY_K_LONG:
+	case JY_K_STR:
+	case JY_K_BOOL:
+		call = JY_OP_CALL;
+		break;
+	default:
+		call = JY_OP_CALLV;
+		break;
+	}
+
+	if (emit_byte(call, ctx->codes, ctx->codesz) != 0)
 		goto PANIC;
 	if (emit_byte(ofunc->param_size, ctx->codes, ctx->codesz) != 0)
 		goto PANIC;
@@ -552,6 +843,17 @@ static bool _and_expr(const struct jy_asts *asts,
 	uint32_t left_id  = asts->child[ast][0];
 	uint32_t right_id = asts->child[ast][1];
 
+	// a side that is always true leaves the other one alone
+	int left  = _static_bool(asts, tkns, left_id);
+	int right = _static_bool(asts, tkns, right_id);
+
+	if (left == 1 || right == 1) {
+		uint32_t id = left == 1 ? right_id : left_id;
+
+		*ctx->foldsz += 1;
+		return _expr(asts, tkns, id, ctx, errs, scope, expr);
+	}
+
 	if (_expr(asts, tkns, left_id, ctx, errs, scope, expr))
 		goto PANIC;
 
@@ -606,6 +908,17 @@ static bool _or_expr(const struct jy_asts *asts,
 	uint32_t left_id  = asts->child[ast][0];
 	uint32_t right_id = asts->child[ast][1];
 
+	// a side that is always false leaves the other one alone
+	int left  = _static_bool(asts, tkns, left_id);
+	int right = _static_bool(asts, tkns, right_id);
+
+	if (left == 0 || right == 0) {
+		uint32_t id = left == 0 ? right_id : left_id;
+
+		*ctx->foldsz += 1;
+		return _expr(asts, tkns, id, ctx, errs, scope, expr);
+	}
+
 	if (_expr(asts, tkns, left_id, ctx, errs, scope, expr))
 		goto PANIC;
 
@@ -821,6 +1134,31 @@ PANIC:
 	return true;
 }
 
+// operands of the concat chain at ast from left to right, a literal
+// part stays whole
+static bool _concat_parts(const struct jy_asts *asts,
+			  const struct jy_tkns *tkns,
+			  uint32_t	        ast,
+			  uint32_t	      **parts,
+			  uint32_t	       *partsz)
+{
+	if (asts->types[ast] != AST_CONCAT
+	    || _static_str(asts, tkns, ast, NULL) >= 0) {
+		jry_mem_push(*parts, *partsz, ast);
+
+		if (*parts == NULL)
+			return true;
+
+		*partsz += 1;
+		return false;
+	}
+
+	return _concat_parts(asts, tkns, asts->child[ast][0], parts, partsz)
+	    || _concat_parts(asts, tkns, asts->child[ast][1], parts, partsz);
+}
+
+// A chain is flattened into one CONCATN over its operands, so the result
+// is sized and written once. Neighbouring literals fold into a constant.
 static bool _concat_expr(const struct jy_asts *asts,
 			 const struct jy_tkns *tkns,
 			 uint32_t	       ast,
@@ -829,39 +1167,99 @@ static bool _concat_expr(const struct jy_asts *asts,
 			 struct jy_defs	      *scope,
 			 struct expr	      *expr)
 {
-	assert(asts->childsz[ast] == 2);
+	int strsz = _static_str(asts, tkns, ast, NULL);
 
-	uint32_t left  = asts->child[ast][0];
-	uint32_t right = asts->child[ast][1];
+	if (strsz >= 0) {
+		char *cstr = jry_alloc(strsz + 1);
 
-	struct expr leftx  = { 0 };
-	struct expr rightx = { 0 };
+		if (cstr == NULL)
+			return true;
 
-	if (_expr(asts, tkns, left, ctx, errs, scope, &leftx))
-		goto PANIC;
+		_static_str(asts, tkns, ast, cstr);
 
-	if (leftx.type != JY_K_STR)
-		goto INV_EXP;
+		bool panic = emit_str(ctx, cstr, strsz, expr);
 
-	if (_expr(asts, tkns, right, ctx, errs, scope, &rightx))
+		*ctx->foldsz += 1;
+		jry_free(cstr);
+		return panic;
+	}
+
+	uint32_t   *parts  = NULL;
+	uint32_t    partsz = 0;
+	char	   *cstr   = NULL;
+	uint32_t    n	   = 0;
+	struct expr x	   = { 0 };
+
+	if (_concat_parts(asts, tkns, ast, &parts, &partsz))
 		goto PANIC;
 
-	if (leftx.type != rightx.type)
-		goto INV_EXP;
+	for (uint32_t i = 0; i < partsz; ++i) {
+		uint32_t j = i;
+		int	 l = 0;
+
+		// a run of literals becomes one constant
+		while (j < partsz) {
+			int c = _static_str(asts, tkns, parts[j], NULL);
+
+			if (c < 0)
+				break;
+
+			l += c;
+			j += 1;
+		}
+
+		if (j - i > 1) {
+			cstr = jry_alloc(l + 1);
+
+			if (cstr == NULL)
+				goto PANIC;
+
+			for (int ofs = 0; i < j; ++i)
+				ofs += _static_str(asts, tkns, parts[i],
+						   cstr + ofs);
+
+			i	      -= 1;
+			*ctx->foldsz  += 1;
+
+			if (emit_str(ctx, cstr, l, &x))
+				goto PANIC;
+
+			jry_free(cstr);
+			cstr = NULL;
+		} else if (_expr(asts, tkns, parts[i], ctx, errs, scope, &x)) {
+			goto PANIC;
+		} else if (x.type != JY_K_STR) {
+			uint32_t from = asts->tkns[parts[0]];
+			uint32_t to   = asts->tkns[parts[i]];
+			tkn_error(errs, "invalid expression", from, to);
+			goto PANIC;
+		}
+
+		// the operand count fits in a byte, longer chains continue
+		// from the partial result
+		if (++n < 0xff)
+			continue;
+
+		if (emit_byte(JY_OP_CONCATN, ctx->codes, ctx->codesz)
+		    || emit_byte(n, ctx->codes, ctx->codesz))
+			goto PANIC;
+
+		n = 1;
+	}
 
-	if (emit_byte(JY_OP_CONCAT, ctx->codes, ctx->codesz))
+	if (n > 1
+	    && (emit_byte(JY_OP_CONCATN, ctx->codes, ctx->codesz)
+		|| emit_byte(n, ctx->codes, ctx->codesz)))
 		goto PANIC;
 
-	*expr = rightx;
+	*expr = x;
 
+	jry_free(parts);
 	return false;
 
-INV_EXP: {
-	uint32_t from = asts->tkns[left];
-	uint32_t to   = asts->tkns[right];
-	tkn_error(errs, "invalid expression", from, to);
-}
 PANIC:
+	jry_free(cstr);
+	jry_free(parts);
 	return true;
 }
 
@@ -1137,6 +1535,13 @@ static bool _arith_expr(const struct jy_asts *asts,
 			struct jy_defs	     *scope,
 			struct expr	     *expr)
 {
+	long value;
+
+	if (_static_long(asts, tkns, ast, &value)) {
+		*ctx->foldsz += 1;
+		return emit_long(ctx, value, expr);
+	}
+
 	assert(asts->childsz[ast] == 2);
 
 	uint32_t left  = asts->child[ast][0];
@@ -1193,30 +1598,181 @@ PANIC:
 	return true;
 }
 
-static inline bool _expr(const struct jy_asts *asts,
-			 const struct jy_tkns *tkns,
-			 uint32_t	       id,
-			 struct compiler      *ctx,
-			 struct tkn_errs      *errs,
-			 struct jy_defs	      *scope,
-			 struct expr	      *expr)
+// true when the expression reads no event, so every row agrees on it
+static bool _rowfree(const struct jy_asts *asts, uint32_t id)
 {
-	enum jy_ast type = asts->types[id];
-	size_t	    tkn	 = asts->tkns[id];
+	if (asts->types[id] == AST_EVENT)
+		return false;
 
-	switch (type) {
-	case AST_CALL:
-		return _call_expr(asts, tkns, id, ctx, errs, scope, expr);
-	case AST_NOT:
-		return _not_expr(asts, tkns, id, ctx, errs, scope, expr);
-	case AST_AND:
-		return _and_expr(asts, tkns, id, ctx, errs, scope, expr);
-	case AST_OR:
-		return _or_expr(asts, tkns, id, ctx, errs, scope, expr);
+	for (uint32_t i = 0; i < asts->childsz[id]; ++i)
+		if (!_rowfree(asts, asts->child[id][i]))
+			return false;
 
-	case AST_JOINX:
-		return _join_expr(asts, tkns, id, ctx, errs, scope, expr);
-	case AST_EQUAL:
+	return true;
+}
+
+// a value computed through a call that every row agrees on
+static inline bool _hoistable(const struct jy_asts *asts, uint32_t id)
+{
+	switch (asts->types[id]) {
+	case AST_CALL:
+	case AST_CONCAT:
+	case AST_ADDITION:
+	case AST_SUBTRACT:
+	case AST_MULTIPLY:
+	case AST_DIVIDE:
+		break;
+	default:
+		return false;
+	}
+
+	return !_pure(asts, id) && _rowfree(asts, id);
+}
+
+// true when every call under id is hoisted, no call is left per row
+static bool _hoists_calls(const struct jy_asts *asts, uint32_t id)
+{
+	if (_hoistable(asts, id))
+		return true;
+
+	if (asts->types[id] == AST_CALL)
+		return false;
+
+	for (uint32_t i = 0; i < asts->childsz[id]; ++i)
+		if (!_hoists_calls(asts, asts->child[id][i]))
+			return false;
+
+	return true;
+}
+
+// worth reading back from the stack instead of computing it again
+static inline bool _shareable(const struct jy_asts *asts,
+			      const struct jy_tkns *tkns,
+			      uint32_t		    id)
+{
+	long value;
+
+	if (asts->childsz[id] == 0 || !_pure(asts, id))
+		return false;
+
+	if (_static_long(asts, tkns, id, &value))
+		return false;
+
+	return _static_str(asts, tkns, id, NULL) < 0
+	    && _static_bool(asts, tkns, id) < 0;
+}
+
+// Compile id into the prologue, once for every spelling of it, and read
+// its register back instead.
+static bool _hoist_expr(const struct jy_asts *asts,
+			const struct jy_tkns *tkns,
+			uint32_t	      id,
+			struct compiler	     *ctx,
+			struct tkn_errs	     *errs,
+			struct jy_defs	     *scope,
+			struct expr	     *expr)
+{
+	uint32_t reg = 0;
+
+	while (reg < ctx->hoistsz && !_same(asts, tkns, ctx->hoists[reg], id))
+		reg += 1;
+
+	if (reg < ctx->hoistsz)
+		goto EMIT;
+
+	uint8_t	 **codes  = ctx->codes;
+	uint32_t  *codesz = ctx->codesz;
+	uint32_t   outsz  = ctx->outsz;
+	uint8_t	 **pcodes = ctx->pcodes;
+
+	ctx->codes  = pcodes;
+	ctx->codesz = ctx->pcodesz;
+	ctx->pcodes = NULL;
+	ctx->outsz  = 0;
+
+	bool panic = _expr(asts, tkns, id, ctx, errs, scope, expr);
+
+	if (!panic && emit_byte(JY_OP_SETR, ctx->codes, ctx->codesz))
+		panic = true;
+
+	if (!panic && emit_byte(reg, ctx->codes, ctx->codesz))
+		panic = true;
+
+	ctx->codes  = codes;
+	ctx->codesz = codesz;
+	ctx->pcodes = pcodes;
+	ctx->outsz  = outsz;
+
+	if (panic)
+		return true;
+
+	ctx->hoists[reg]   = id;
+	ctx->hoistts[reg]  = expr->type;
+	ctx->hoistsz	  += 1;
+
+EMIT:
+	if (emit_byte(JY_OP_GETR, ctx->codes, ctx->codesz))
+		return true;
+
+	if (emit_byte(reg, ctx->codes, ctx->codesz))
+		return true;
+
+	expr->id   = -1u;
+	expr->type = ctx->hoistts[reg];
+
+	return false;
+}
+
+static inline bool _expr(const struct jy_asts *asts,
+			 const struct jy_tkns *tkns,
+			 uint32_t	       id,
+			 struct compiler      *ctx,
+			 struct tkn_errs      *errs,
+			 struct jy_defs	      *scope,
+			 struct expr	      *expr)
+{
+	enum jy_ast type = asts->types[id];
+	size_t	    tkn	 = asts->tkns[id];
+
+	if (ctx->outsz && _shareable(asts, tkns, id)) {
+		for (uint32_t i = 0; i < ctx->outsz; ++i) {
+			// predicates leave no value behind
+			if (ctx->outts[i] == JY_K_BOOL)
+				continue;
+
+			if (!_same(asts, tkns, ctx->outs[i], id))
+				continue;
+
+			if (emit_byte(JY_OP_DUP, ctx->codes, ctx->codesz))
+				goto OUT_OF_MEMORY;
+
+			if (emit_byte(i, ctx->codes, ctx->codesz))
+				goto OUT_OF_MEMORY;
+
+			expr->id	= -1u;
+			expr->type	= ctx->outts[i];
+			*ctx->sharesz += 1;
+
+			return false;
+		}
+	}
+
+	if (ctx->pcodes && ctx->hoistsz < 0xff && _hoistable(asts, id))
+		return _hoist_expr(asts, tkns, id, ctx, errs, scope, expr);
+
+	switch (type) {
+	case AST_CALL:
+		return _call_expr(asts, tkns, id, ctx, errs, scope, expr);
+	case AST_NOT:
+		return _not_expr(asts, tkns, id, ctx, errs, scope, expr);
+	case AST_AND:
+		return _and_expr(asts, tkns, id, ctx, errs, scope, expr);
+	case AST_OR:
+		return _or_expr(asts, tkns, id, ctx, errs, scope, expr);
+
+	case AST_JOINX:
+		return _join_expr(asts, tkns, id, ctx, errs, scope, expr);
+	case AST_EQUAL:
 	case AST_EXACT:
 		return _exact_expr(asts, tkns, id, ctx, errs, scope, expr);
 	case AST_BETWEEN:
@@ -1322,13 +1878,309 @@ static inline bool _match_sect(const struct jy_asts *asts,
 	return false;
 }
 
+// collect the events queried by a match section
+static void _match_events(const struct jy_asts *asts,
+			  const struct jy_tkns *tkns,
+			  uint32_t		id,
+			  uint32_t	       *eventsz,
+			  const char	      **events)
+{
+	uint32_t   *child   = asts->child[id];
+	uint32_t    childsz = asts->childsz[id];
+	enum jy_ast type    = asts->types[id];
+
+	// the right side of an access is a member, not an event
+	if (type == AST_QACCESS || type == AST_EACCESS)
+		childsz = 1;
+
+	for (uint32_t i = 0; i < childsz; ++i)
+		_match_events(asts, tkns, child[i], eventsz, events);
+
+	if (type != AST_EVENT || *eventsz >= 255)
+		return;
+
+	const char *lexeme = tkns->lexemes[asts->tkns[id]];
+
+	for (uint32_t i = 0; i < *eventsz; ++i)
+		if (strcmp(events[i], lexeme) == 0)
+			return;
+
+	events[*eventsz]  = lexeme;
+	*eventsz	 += 1;
+}
+
+#define SIZE() bufsz ? bufsz - sz : 0
+#define PTR()  sz ? buf + sz : buf
+
+// print a predicate operand SQLite can read on its own, -1 if it can't
+static int _properand(int bufsz,
+		      char *restrict buf,
+		      const struct jy_asts *asts,
+		      const struct jy_tkns *tkns,
+		      uint32_t		    id,
+		      uint32_t		    eventsz,
+		      const char	  **events)
+{
+	int	    sz	   = 0;
+	uint32_t    tkn	   = asts->tkns[id];
+	const char *lexeme = tkns->lexemes[tkn];
+
+	switch (asts->types[id]) {
+	case AST_EACCESS: {
+		uint32_t event = asts->child[id][0];
+		uint32_t field = asts->child[id][1];
+
+		if (asts->types[event] != AST_EVENT)
+			return -1;
+
+		switch (asts->types[field]) {
+		case AST_NAME:
+		case AST_EVENT:
+			break;
+		default:
+			return -1;
+		}
+
+		const char *t = tkns->lexemes[asts->tkns[event]];
+		const char *c = tkns->lexemes[asts->tkns[field]];
+		uint32_t    i = 0;
+
+		// only events that are part of the query can be filtered
+		while (i < eventsz && strcmp(events[i], t) != 0)
+			i += 1;
+
+		if (i == eventsz)
+			return -1;
+
+		sz += snprintf(PTR(), SIZE(), "%s.%s", t, c);
+		break;
+	}
+	case AST_LONG:
+		sz += snprintf(PTR(), SIZE(), "%ld", strtol(lexeme, NULL, 10));
+		break;
+	case AST_STRING:
+		sz += snprintf(PTR(), SIZE(), "'");
+
+		// skip the quotes, escape '
+		for (uint32_t i = 1; i + 1 < tkns->lexsz[tkn]; ++i) {
+			if (lexeme[i] == '\'')
+				sz += snprintf(PTR(), SIZE(), "''");
+			else
+				sz += snprintf(PTR(), SIZE(), "%c", lexeme[i]);
+		}
+
+		sz += snprintf(PTR(), SIZE(), "'");
+		break;
+	case AST_TRUE:
+		sz += snprintf(PTR(), SIZE(), "1");
+		break;
+	case AST_FALSE:
+		sz += snprintf(PTR(), SIZE(), "0");
+		break;
+	default:
+		return -1;
+	}
+
+	return sz;
+}
+
+// what an operand of a pushed down comparison orders by when the field
+// on the other side is unset and reads as 0, "" or false: a string only
+// by whether it is empty
+static long _prkey(const struct jy_asts *asts,
+		   const struct jy_tkns *tkns,
+		   uint32_t		 id)
+{
+	uint32_t tkn = asts->tkns[id];
+
+	switch (asts->types[id]) {
+	case AST_LONG:
+		return strtol(tkns->lexemes[tkn], NULL, 10);
+	case AST_STRING:
+		return tkns->lexsz[tkn] > 2;
+	case AST_TRUE:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+// print a comparison of a field with a literal, or of two literals
+static int _prcompare(int bufsz,
+		      char *restrict buf,
+		      const struct jy_asts *asts,
+		      const struct jy_tkns *tkns,
+		      uint32_t		    id,
+		      uint32_t		    eventsz,
+		      const char	  **events,
+		      bool		    neg)
+{
+	int	    sz	  = 0;
+	int	    len	  = 0;
+	uint32_t    left  = asts->child[id][0];
+	uint32_t    right = asts->child[id][1];
+	bool	    lfld  = asts->types[left] == AST_EACCESS;
+	bool	    rfld  = asts->types[right] == AST_EACCESS;
+	long	    x	  = _prkey(asts, tkns, left);
+	long	    y	  = _prkey(asts, tkns, right);
+	const char *op;
+	bool	    unset;
+
+	// whether the comparison holds with the field unset
+	switch (asts->types[id]) {
+	case AST_EQUALITY:
+		op    = " = ";
+		unset = x == y;
+		break;
+	case AST_LESSER:
+		op    = " < ";
+		unset = x < y;
+		break;
+	default:
+		op    = " > ";
+		unset = x > y;
+		break;
+	}
+
+	// both sides may be unset, nothing an index helps with anyway
+	if (lfld && rfld)
+		return -1;
+
+	sz += snprintf(PTR(), SIZE(), "(");
+	len = _properand(SIZE(), PTR(), asts, tkns, left, eventsz, events);
+
+	if (len < 0)
+		return -1;
+
+	sz += len;
+	sz += snprintf(PTR(), SIZE(), "%s", op);
+	len = _properand(SIZE(), PTR(), asts, tkns, right, eventsz, events);
+
+	if (len < 0)
+		return -1;
+
+	sz += len;
+
+	// SQL compares a NULL column to NULL, the VM reads it as 0 or "".
+	// The column stays bare for its index and NULL is only spelled out
+	// when it changes the outcome. NOT of NULL is NULL, so under a NOT
+	// the comparison has to be false instead
+	if ((lfld || rfld) && (unset || neg)) {
+		sz += snprintf(PTR(), SIZE(), unset ? " OR " : " AND ");
+		sz += _properand(SIZE(), PTR(), asts, tkns, lfld ? left : right,
+				 eventsz, events);
+		sz += snprintf(PTR(), SIZE(), unset ? " IS NULL"
+						    : " IS NOT NULL");
+	}
+
+	sz += snprintf(PTR(), SIZE(), ")");
+
+	return sz;
+}
+
+// print a condition predicate SQLite can evaluate on its own, -1 if it
+// can't. neg is set under an odd number of NOT
+static int _prpred(int bufsz,
+		   char *restrict buf,
+		   const struct jy_asts *asts,
+		   const struct jy_tkns *tkns,
+		   uint32_t		 id,
+		   uint32_t		 eventsz,
+		   const char	       **events,
+		   bool			 neg)
+{
+	int	    sz	  = 0;
+	int	    len	  = 0;
+	uint32_t   *child = asts->child[id];
+	const char *op;
+
+	switch (asts->types[id]) {
+	case AST_TRUE:
+	case AST_FALSE:
+		return _properand(bufsz, buf, asts, tkns, id, eventsz, events);
+	case AST_NOT:
+		sz  += snprintf(PTR(), SIZE(), "NOT ");
+		len  = _prpred(SIZE(), PTR(), asts, tkns, child[0], eventsz,
+			       events, !neg);
+
+		return len < 0 ? -1 : sz + len;
+	case AST_AND:
+		op = " AND ";
+		break;
+	case AST_OR:
+		op = " OR ";
+		break;
+	case AST_EQUALITY:
+	case AST_LESSER:
+	case AST_GREATER:
+		return _prcompare(bufsz, buf, asts, tkns, id, eventsz, events,
+				  neg);
+	default:
+		return -1;
+	}
+
+	sz += snprintf(PTR(), SIZE(), "(");
+	len = _prpred(SIZE(), PTR(), asts, tkns, child[0], eventsz, events,
+		      neg);
+
+	if (len < 0)
+		return -1;
+
+	sz += len;
+	sz += snprintf(PTR(), SIZE(), "%s", op);
+	len = _prpred(SIZE(), PTR(), asts, tkns, child[1], eventsz, events,
+		      neg);
+
+	if (len < 0)
+		return -1;
+
+	sz += len;
+	sz += snprintf(PTR(), SIZE(), ")");
+
+	return sz;
+}
+
+#undef SIZE
+#undef PTR
+
+// append a pushed down predicate to the rule WHERE clause
+static inline bool _where_push(char		     **where,
+			       const struct jy_asts *asts,
+			       const struct jy_tkns *tkns,
+			       uint32_t		     id,
+			       int		     predsz,
+			       uint32_t		     eventsz,
+			       const char	   **events)
+{
+	size_t oldsz = *where ? strlen(*where) : 0;
+	size_t sepsz = oldsz ? strlen(" AND ") : 0;
+	char  *mem   = jry_realloc(*where, oldsz + sepsz + predsz + 1);
+
+	if (mem == NULL)
+		return true;
+
+	if (sepsz)
+		memcpy(mem + oldsz, " AND ", sepsz);
+
+	_prpred(predsz + 1, mem + oldsz + sepsz, asts, tkns, id, eventsz,
+		events, false);
+
+	*where = mem;
+
+	return false;
+}
+
 static inline bool _condition_sect(const struct jy_asts *asts,
 				   const struct jy_tkns *tkns,
 				   uint32_t		 sect,
 				   struct compiler	*ctx,
 				   struct tkn_errs	*errs,
 				   uint32_t	       **patchofs,
-				   uint32_t		*patchsz)
+				   uint32_t		*patchsz,
+				   uint32_t		 eventsz,
+				   const char	       **events,
+				   char		       **where,
+				   bool			*never)
 {
 	uint32_t  sectkn  = asts->tkns[sect];
 	uint32_t *child	  = asts->child[sect];
@@ -1344,6 +2196,16 @@ static inline bool _condition_sect(const struct jy_asts *asts,
 		uint32_t    chtkn = asts->tkns[chid];
 		enum jy_ast type  = asts->types[chid];
 		struct expr expr  = { 0 };
+		uint32_t    codesz = *ctx->codesz;
+		uint32_t    readsz = *ctx->readsz;
+		int	    known  = _static_bool(asts, tkns, chid);
+
+		// nothing to test, or nothing will ever pass
+		if (known >= 0) {
+			*ctx->foldsz += 1;
+			*never	     |= !known;
+			continue;
+		}
 
 		if (_expr(asts, tkns, chid, ctx, errs, ctx->names, &expr))
 			continue;
@@ -1354,6 +2216,20 @@ static inline bool _condition_sect(const struct jy_asts *asts,
 			continue;
 		}
 
+		int predsz = _prpred(0, NULL, asts, tkns, chid, eventsz,
+				     events, false);
+
+		// SQLite filters the rows, drop the code
+		if (predsz > 0) {
+			if (_where_push(where, asts, tkns, chid, predsz,
+					eventsz, events))
+				goto PANIC;
+
+			*ctx->codesz = codesz;
+			*ctx->readsz = readsz;
+			continue;
+		}
+
 		switch (type) {
 		case AST_TRUE:
 		case AST_FALSE:
@@ -1415,11 +2291,686 @@ PANIC:
 	return true;
 }
 
+// the single time of a suppress section, in seconds
+static inline bool _suppress_sect(const struct jy_asts *asts,
+				  const struct jy_tkns *tkns,
+				  uint32_t		sect,
+				  struct tkn_errs      *errs,
+				  uint32_t	       *window)
+{
+	uint32_t *child	  = asts->child[sect];
+	uint32_t  childsz = asts->childsz[sect];
+	uint32_t  from	  = asts->tkns[sect];
+	long	  unit	  = 0;
+
+	if (childsz != 1) {
+		tkn_error(errs, "suppress expects a single time", from, from);
+		goto PANIC;
+	}
+
+	switch (asts->types[child[0]]) {
+	case AST_HOUR:
+		unit = JY_TIME_HOUR;
+		break;
+	case AST_MINUTE:
+		unit = JY_TIME_MINUTE;
+		break;
+	case AST_SECOND:
+		unit = JY_TIME_SECOND;
+		break;
+	default: {
+		uint32_t to = asts->tkns[child[0]];
+		tkn_error(errs, "suppress expects a time", from, to);
+		goto PANIC;
+	}
+	}
+
+	uint32_t tkn = asts->tkns[child[0]];
+	long	 num = strtol(tkns->lexemes[tkn], NULL, 10);
+
+	if (num <= 0 || num * unit > UINT32_MAX) {
+		tkn_error(errs, "invalid suppress time", from, tkn);
+		goto PANIC;
+	}
+
+	*window = num * unit;
+
+	return false;
+PANIC:
+	return true;
+}
+
+// constant pushed by the PUSH at pc, -1u if pc is not a PUSH
+static inline uint32_t pushed(const uint8_t *pc)
+{
+	switch (*pc) {
+	case JY_OP_PUSH8:
+		return pc[1];
+	case JY_OP_PUSH16:
+		return pc[1] | pc[2] << 8;
+	default:
+		return -1u;
+	}
+}
+
+// abstract stack slot of the verifier, k is the constant it came from
+struct vslot {
+	uint32_t      k;
+	enum jy_ktype t;
+};
+
+// Type of the member a descriptor points to, JY_K_UNKNOWN if it does not
+// point anywhere.
+static enum jy_ktype desc_type(const union jy_value *vals,
+			       const enum jy_ktype  *types,
+			       uint32_t		     valsz,
+			       uint32_t		     k)
+{
+	if (k >= valsz || types[k] != JY_K_DESCRIPTOR)
+		return JY_K_UNKNOWN;
+
+	struct jy_desc d = vals[k].dscptr;
+
+	if (d.name >= valsz)
+		return JY_K_UNKNOWN;
+
+	if (types[d.name] != JY_K_EVENT && types[d.name] != JY_K_MODULE)
+		return JY_K_UNKNOWN;
+
+	const struct jy_defs *def = vals[d.name].def;
+
+	if (d.member >= def->capacity)
+		return JY_K_UNKNOWN;
+
+	// match expressions find the table through __name__
+	if (types[d.name] == JY_K_EVENT && !def_find(def, "__name__", NULL))
+		return JY_K_UNKNOWN;
+
+	return def->types[d.member];
+}
+
+// Prove the chunk at codes keeps its stack balanced, feeds every opcode
+// the operand types it expects and only jumps forward to an instruction
+// boundary. Writes the maximum stack depth on success, the interpreter
+// checks none of this at runtime. Registers take the type of what is set
+// in them, a register is read only once it has one.
+static bool verify_chunk(const uint8_t	      *codes,
+			 uint32_t	       len,
+			 const union jy_value *vals,
+			 const enum jy_ktype  *types,
+			 uint32_t	       valsz,
+			 enum jy_ktype	      *regt,
+			 uint32_t	       regsz,
+			 uint32_t	      *maxdepth)
+{
+#define NEED(__n)                     \
+	if (depth < (__n))            \
+		goto INVALID;         \
+	else                          \
+		(void) 0
+#define TOP(__i)  (slot[depth - 1 - (__i)])
+#define IS(__i, __t) (TOP(__i).t == (__t))
+#define INT(__i)     (IS(__i, JY_K_LONG) || IS(__i, JY_K_BOOL))
+
+	bool	      invalid = true;
+	struct vslot *slot    = jry_alloc((len + 1) * sizeof(*slot));
+	uint32_t     *tdepth  = jry_alloc((len + 1) * sizeof(*tdepth));
+	uint32_t      depth   = 0;
+	uint32_t      max     = 0;
+	uint32_t      pc      = 0;
+
+	if (slot == NULL || tdepth == NULL)
+		goto FINISH;
+
+	memset(tdepth, 0xff, (len + 1) * sizeof(*tdepth));
+
+	for (; pc < len && codes[pc] != JY_OP_END; pc += jry_oplen(codes[pc])) {
+		const uint8_t *op = codes + pc;
+
+		if (pc + jry_oplen(*op) > len)
+			goto INVALID;
+
+		// every way into an instruction agrees on the stack
+		if (tdepth[pc] != -1u && tdepth[pc] != depth)
+			goto INVALID;
+
+		switch (*op) {
+		case JY_OP_PUSH8:
+		case JY_OP_PUSH16: {
+			uint32_t k = pushed(op);
+
+			if (k >= valsz)
+				goto INVALID;
+
+			slot[depth++] = (struct vslot) { k, types[k] };
+			break;
+		}
+		case JY_OP_SETR:
+			NEED(1);
+
+			if (op[1] >= regsz)
+				goto INVALID;
+
+			regt[op[1]]  = TOP(0).t;
+			depth	    -= 1;
+			break;
+		case JY_OP_GETR:
+			if (op[1] >= regsz || regt[op[1]] == JY_K_UNKNOWN)
+				goto INVALID;
+
+			slot[depth++] = (struct vslot) { -1u, regt[op[1]] };
+			break;
+		case JY_OP_DUP:
+			if (op[1] >= depth)
+				goto INVALID;
+
+			slot[depth] = slot[op[1]];
+			depth	   += 1;
+			break;
+		case JY_OP_LOAD: {
+			NEED(1);
+
+			enum jy_ktype t = desc_type(vals, types, valsz,
+						    TOP(0).k);
+
+			if (!IS(0, JY_K_DESCRIPTOR) || t == JY_K_UNKNOWN)
+				goto INVALID;
+
+			TOP(0).t = t;
+			break;
+		}
+		case JY_OP_CALL:
+		case JY_OP_CALLV: {
+			uint8_t paramsz = op[1];
+
+			NEED(paramsz + 1u);
+
+			if (!IS(paramsz, JY_K_FUNC))
+				goto INVALID;
+
+			struct jy_desc	d    = vals[TOP(paramsz).k].dscptr;
+			struct jy_func *func = vals[d.name]
+						       .def->vals[d.member]
+						       .func;
+
+			if (func->param_size != paramsz)
+				goto INVALID;
+
+			for (uint32_t i = 0; i < paramsz; ++i)
+				if (!IS(paramsz - 1 - i, func->param_types[i]))
+					goto INVALID;
+
+			depth -= paramsz + 1;
+
+			switch (func->return_type) {
+			case JY_K_LONG:
+			case JY_K_STR:
+			case JY_K_BOOL:
+				if (*op != JY_OP_CALL)
+					goto INVALID;
+
+				slot[depth++] = (struct vslot) {
+					-1u, func->return_type
+				};
+				break;
+			default:
+				if (*op != JY_OP_CALLV)
+					goto INVALID;
+				break;
+			}
+			break;
+		}
+		case JY_OP_OUTPUT: {
+			NEED(1);
+
+			if (!IS(0, JY_K_ULONG) || TOP(0).k == -1u)
+				goto INVALID;
+
+			uint64_t outsz = vals[TOP(0).k].u64;
+
+			NEED(outsz + 1);
+
+			depth -= outsz + 1;
+			break;
+		}
+		case JY_OP_QUERY:
+			NEED(2);
+
+			if (!IS(0, JY_K_RULE) || !IS(1, JY_K_LONG))
+				goto INVALID;
+
+			if (TOP(1).k == -1u)
+				goto INVALID;
+
+			// takes every match handle and the rule
+			if (depth != vals[TOP(1).k].u64 + 2)
+				goto INVALID;
+
+			for (uint32_t i = 2; i < depth; ++i)
+				if (!IS(i, JY_K_HANDLE))
+					goto INVALID;
+
+			depth = 0;
+			break;
+		case JY_OP_BETWEEN:
+			NEED(3);
+
+			if (!IS(0, JY_K_LONG) || !IS(1, JY_K_LONG))
+				goto INVALID;
+
+			if (desc_type(vals, types, valsz, TOP(2).k)
+			    != JY_K_LONG)
+				goto INVALID;
+
+			depth	 -= 2;
+			TOP(0)	  = (struct vslot) { -1u, JY_K_HANDLE };
+			break;
+		case JY_OP_WITHIN:
+			NEED(2);
+
+			if (!IS(0, JY_K_TIME))
+				goto INVALID;
+
+			if (desc_type(vals, types, valsz, TOP(1).k)
+			    != JY_K_EVENT)
+				goto INVALID;
+
+			depth	 -= 1;
+			TOP(0)	  = (struct vslot) { -1u, JY_K_HANDLE };
+			break;
+		case JY_OP_REGEX:
+			NEED(2);
+
+			// patterns are pooled as strings
+			if (!IS(0, JY_K_STR))
+				goto INVALID;
+
+			if (desc_type(vals, types, valsz, TOP(1).k)
+			    != JY_K_STR)
+				goto INVALID;
+
+			depth	 -= 1;
+			TOP(0)	  = (struct vslot) { -1u, JY_K_HANDLE };
+			break;
+		case JY_OP_EQUAL: {
+			NEED(2);
+
+			enum jy_ktype t = desc_type(vals, types, valsz,
+						    TOP(1).k);
+
+			if (t != JY_K_LONG && t != JY_K_STR)
+				goto INVALID;
+
+			if (!IS(0, t))
+				goto INVALID;
+
+			depth	 -= 1;
+			TOP(0)	  = (struct vslot) { -1u, JY_K_HANDLE };
+			break;
+		}
+		case JY_OP_JOIN: {
+			NEED(2);
+
+			enum jy_ktype t1 = desc_type(vals, types, valsz,
+						     TOP(1).k);
+			enum jy_ktype t2 = desc_type(vals, types, valsz,
+						     TOP(0).k);
+
+			if (t1 == JY_K_UNKNOWN || t2 == JY_K_UNKNOWN)
+				goto INVALID;
+
+			if (types[vals[TOP(1).k].dscptr.name] != JY_K_EVENT
+			    || types[vals[TOP(0).k].dscptr.name]
+				       != JY_K_EVENT)
+				goto INVALID;
+
+			depth	 -= 1;
+			TOP(0)	  = (struct vslot) { -1u, JY_K_HANDLE };
+			break;
+		}
+		case JY_OP_ADD:
+		case JY_OP_SUB:
+		case JY_OP_MUL:
+		case JY_OP_DIV:
+			NEED(2);
+
+			if (!IS(0, JY_K_LONG) || !IS(1, JY_K_LONG))
+				goto INVALID;
+
+			depth	 -= 1;
+			TOP(0)	  = (struct vslot) { -1u, JY_K_LONG };
+			break;
+		case JY_OP_CONCATN:
+			if (op[1] < 2)
+				goto INVALID;
+
+			NEED(op[1]);
+
+			for (uint32_t i = 0; i < op[1]; ++i)
+				if (!IS(i, JY_K_STR))
+					goto INVALID;
+
+			depth	 -= op[1] - 1;
+			TOP(0)	  = (struct vslot) { -1u, JY_K_STR };
+			break;
+		case JY_OP_CMPSTR:
+			NEED(2);
+
+			if (!IS(0, JY_K_STR) || !IS(1, JY_K_STR))
+				goto INVALID;
+
+			depth -= 2;
+			break;
+		case JY_OP_CMP:
+			NEED(2);
+
+			// true and false are pushed as long constants and a
+			// bool is held in i64 anyway, mixing them is fine
+			if (!INT(0) || !INT(1))
+				goto INVALID;
+
+			depth -= 2;
+			break;
+		case JY_OP_LT:
+		case JY_OP_GT:
+			NEED(2);
+
+			if (!IS(0, JY_K_LONG) || !IS(1, JY_K_LONG))
+				goto INVALID;
+
+			depth -= 2;
+			break;
+		case JY_OP_CMPSTR_FK:
+		case JY_OP_CMP_FK:
+		case JY_OP_LT_FK:
+		case JY_OP_GT_FK: {
+			uint32_t      d	     = op[1] | op[2] << 8;
+			uint32_t      k	     = op[3] | op[4] << 8;
+			enum jy_ktype expect = *op == JY_OP_CMPSTR_FK
+						     ? JY_K_STR
+						     : JY_K_LONG;
+			enum jy_ktype field  = desc_type(vals, types, valsz, d);
+			enum jy_ktype konst  = JY_K_UNKNOWN;
+
+			if (k < valsz)
+				konst = types[k];
+
+			if (field == JY_K_UNKNOWN)
+				goto INVALID;
+
+			if (types[vals[d].dscptr.name] != JY_K_EVENT)
+				goto INVALID;
+
+			// like CMP, equality mixes bools and longs
+			if (*op == JY_OP_CMP_FK && field == JY_K_BOOL)
+				field = JY_K_LONG;
+
+			if (*op == JY_OP_CMP_FK && konst == JY_K_BOOL)
+				konst = JY_K_LONG;
+
+			if (field != expect || konst != expect)
+				goto INVALID;
+			break;
+		}
+		case JY_OP_SETBF8:
+			NEED(1);
+
+			if (!IS(0, JY_K_BOOL))
+				goto INVALID;
+
+			depth -= 1;
+			break;
+		case JY_OP_NOT:
+			break;
+		case JY_OP_JMPF:
+		case JY_OP_JMPT: {
+			int16_t off;
+			memcpy(&off, op + 1, sizeof(off));
+
+			uint32_t to = pc + off;
+
+			if (off <= 0 || to > len)
+				goto INVALID;
+
+			if (tdepth[to] != -1u && tdepth[to] != depth)
+				goto INVALID;
+
+			tdepth[to] = depth;
+			break;
+		}
+		default:
+			goto INVALID;
+		}
+
+		if (depth > max)
+			max = depth;
+	}
+
+	if (pc >= len || (tdepth[pc] != -1u && tdepth[pc] != depth))
+		goto INVALID;
+
+	// a jump that skipped END or landed inside an instruction
+	for (uint32_t i = pc + 1; i <= len; ++i)
+		if (tdepth[i] != -1u)
+			goto INVALID;
+
+	for (uint32_t i = 0; i < pc; i += jry_oplen(codes[i]))
+		for (uint32_t at = i + 1; at < i + jry_oplen(codes[i]); ++at)
+			if (tdepth[at] != -1u)
+				goto INVALID;
+
+	*maxdepth = max;
+	invalid	  = false;
+
+INVALID:
+FINISH:
+	jry_free(slot);
+	jry_free(tdepth);
+
+	return invalid;
+#undef INT
+#undef IS
+#undef TOP
+#undef NEED
+}
+
+// Length of the leading conditions of a verified free chunk that only
+// compare and combine long event fields. They have no side effects, so
+// the executor may run them over many rows at once and drop the failing
+// ones before running the rest of the chunk per row.
+static uint32_t batch_prefix(const uint8_t	  *codes,
+			     const union jy_value *vals,
+			     const enum jy_ktype  *types,
+			     uint32_t		   valsz)
+{
+	uint32_t prefix = 0;
+	uint32_t pc	= 0;
+
+	for (; codes[pc] != JY_OP_END; pc += jry_oplen(codes[pc])) {
+		const uint8_t *op = codes + pc;
+
+		switch (*op) {
+		case JY_OP_PUSH8:
+		case JY_OP_PUSH16: {
+			uint32_t      k = pushed(op);
+			enum jy_ktype t = types[k];
+
+			if (t == JY_K_LONG)
+				break;
+
+			// only an event field that is loaded right away
+			if (op[jry_oplen(*op)] != JY_OP_LOAD)
+				return prefix;
+
+			if (desc_type(vals, types, valsz, k) != JY_K_LONG)
+				return prefix;
+
+			if (types[vals[k].dscptr.name] != JY_K_EVENT)
+				return prefix;
+			break;
+		}
+		case JY_OP_CMP_FK:
+		case JY_OP_LT_FK:
+		case JY_OP_GT_FK:
+		case JY_OP_LOAD:
+		case JY_OP_ADD:
+		case JY_OP_SUB:
+		case JY_OP_MUL:
+		case JY_OP_CMP:
+		case JY_OP_LT:
+		case JY_OP_GT:
+		case JY_OP_NOT:
+			break;
+		case JY_OP_JMPF: {
+			int16_t off;
+			memcpy(&off, op + 1, sizeof(off));
+
+			// a false flag must always end up failing the row, so
+			// the jump lands on END or on another such JMPF
+			uint32_t to = pc + off;
+
+			while (codes[to] == JY_OP_JMPF) {
+				memcpy(&off, codes + to + 1, sizeof(off));
+				to += off;
+			}
+
+			if (codes[to] != JY_OP_END)
+				return prefix;
+
+			prefix = pc + jry_oplen(*op);
+			break;
+		}
+		default:
+			return prefix;
+		}
+	}
+
+	return prefix;
+}
+
+// Fuse PUSH desc; LOAD; PUSH k; <cmp> into one <cmp>_FK with two 16 bit
+// operands, then fix up the jumps over the shrunk chunk.
+static int peephole(uint8_t		**codes,
+		    uint32_t		 *codesz,
+		    uint32_t		  start,
+		    const union jy_value *vals,
+		    const enum jy_ktype	 *types)
+{
+	uint8_t *code = *codes + start;
+	uint32_t len  = *codesz - start;
+
+	// old offset to new offset, which offsets are jumped to, new chunk
+	uint32_t *newofs = jry_alloc((len + 1) * (sizeof(*newofs) + 2));
+
+	if (newofs == NULL)
+		return -1;
+
+	bool	*target = (bool *) (newofs + len + 1);
+	uint8_t *out	= (uint8_t *) (target + len + 1);
+	uint32_t outsz	= 0;
+
+	memset(target, 0, (len + 1) * sizeof(*target));
+
+	for (uint32_t pc = 0; pc < len; pc += jry_oplen(code[pc])) {
+		if (code[pc] != JY_OP_JMPF && code[pc] != JY_OP_JMPT)
+			continue;
+
+		int16_t off;
+		memcpy(&off, code + pc + 1, sizeof(off));
+		target[pc + off] = true;
+	}
+
+	for (uint32_t pc = 0; pc < len;) {
+		uint32_t d    = pushed(code + pc);
+		uint32_t load = pc + jry_oplen(code[pc]);
+
+		newofs[pc] = outsz;
+
+		if (d == -1u || types[d] != JY_K_DESCRIPTOR)
+			goto COPY;
+
+		if (types[vals[d].dscptr.name] != JY_K_EVENT)
+			goto COPY;
+
+		if (load >= len || code[load] != JY_OP_LOAD || target[load])
+			goto COPY;
+
+		uint32_t kpc = load + 1;
+		uint32_t k   = kpc < len ? pushed(code + kpc) : -1u;
+
+		if (k == -1u || target[kpc])
+			goto COPY;
+
+		uint32_t oppc = kpc + jry_oplen(code[kpc]);
+
+		if (oppc >= len || target[oppc])
+			goto COPY;
+
+		uint8_t fused;
+
+		switch (code[oppc]) {
+		case JY_OP_CMPSTR:
+			fused = JY_OP_CMPSTR_FK;
+			break;
+		case JY_OP_CMP:
+			fused = JY_OP_CMP_FK;
+			break;
+		case JY_OP_LT:
+			fused = JY_OP_LT_FK;
+			break;
+		case JY_OP_GT:
+			fused = JY_OP_GT_FK;
+			break;
+		default:
+			goto COPY;
+		}
+
+		out[outsz++] = fused;
+		out[outsz++] = d & 0xff;
+		out[outsz++] = d >> 8;
+		out[outsz++] = k & 0xff;
+		out[outsz++] = k >> 8;
+
+		// nothing jumps inside the sequence
+		newofs[load] = newofs[kpc] = newofs[oppc] = newofs[pc];
+		pc	     = oppc + 1;
+		continue;
+COPY:
+		memcpy(out + outsz, code + pc, jry_oplen(code[pc]));
+		outsz += jry_oplen(code[pc]);
+		pc    += jry_oplen(code[pc]);
+	}
+
+	newofs[len] = outsz;
+
+	for (uint32_t pc = 0; pc < len; pc += jry_oplen(code[pc])) {
+		if (code[pc] != JY_OP_JMPF && code[pc] != JY_OP_JMPT)
+			continue;
+
+		int16_t off;
+		memcpy(&off, code + pc + 1, sizeof(off));
+
+		uint32_t from = newofs[pc];
+		int16_t	 jmp  = newofs[pc + off] - from;
+
+		memcpy(out + from + 1, &jmp, sizeof(jmp));
+	}
+
+	memcpy(code, out, outsz);
+	*codesz = start + outsz;
+
+	jry_free(newofs);
+
+	return 0;
+}
+
 static inline bool _output_sect(const struct jy_asts *asts,
 				const struct jy_tkns *tkns,
 				uint32_t	      sect,
 				struct compiler	     *ctx,
-				struct tkn_errs	     *errs)
+				struct tkn_errs	     *errs,
+				enum jy_ktype	    **outtypes,
+				uint32_t	     *outtypesz)
 {
 	uint32_t *child	  = asts->child[sect];
 	uint32_t  childsz = asts->childsz[sect];
@@ -1428,8 +2979,15 @@ static inline bool _output_sect(const struct jy_asts *asts,
 		uint32_t    chid = child[i];
 		struct expr expr = { 0 };
 
+		// the earlier outputs sit in slots 0 to i - 1
+		ctx->outs  = child;
+		ctx->outts = i ? *outtypes + *outtypesz - i : NULL;
+		ctx->outsz = i <= 0xff ? i : 0x100;
+
 		_expr(asts, tkns, chid, ctx, errs, ctx->names, &expr);
 
+		ctx->outsz = 0;
+
 		switch (expr.type) {
 		case JY_K_LONG:
 		case JY_K_ULONG:
@@ -1443,6 +3001,13 @@ static inline bool _output_sect(const struct jy_asts *asts,
 			goto PANIC;
 		}
 		}
+
+		jry_mem_push(*outtypes, *outtypesz, expr.type);
+
+		if (*outtypes == NULL)
+			goto OUT_OF_MEMORY;
+
+		*outtypesz += 1;
 	}
 
 	size_t		valsz	 = *ctx->valsz;
@@ -1457,6 +3022,7 @@ static inline bool _output_sect(const struct jy_asts *asts,
 		if (t != JY_K_ULONG || v != childsz)
 			continue;
 
+		outsz_id = i;
 		goto EMIT_OUTPUT;
 	}
 
@@ -1538,7 +3104,7 @@ static inline int emit_query(uint16_t	     *valsz,
 			     uint32_t	     *codesz,
 			     uint8_t	    **codes,
 			     long	      qlen,
-			     size_t	      chunkid)
+			     size_t	      ruleid)
 {
 	uint32_t id = *valsz;
 
@@ -1562,7 +3128,7 @@ EMIT_QUERY:
 	if (emit_push(id, codes, codesz))
 		goto OUT_OF_MEMORY;
 
-	if (emit_push(chunkid, codes, codesz))
+	if (emit_push(ruleid, codes, codesz))
 		goto OUT_OF_MEMORY;
 
 	if (emit_byte(JY_OP_QUERY, codes, codesz))
@@ -1600,11 +3166,13 @@ static inline bool _rule_decl(const struct jy_asts *asts,
 	uint32_t actions[255];
 	uint32_t conds[255];
 	uint32_t outputs[255];
+	uint32_t sups[255];
 
 	uint32_t	matchsz	 = 0;
 	uint32_t	actionsz = 0;
 	uint32_t	condsz	 = 0;
 	uint32_t	outputsz = 0;
+	uint32_t	supsz	 = 0;
 	struct jy_defs *names	 = jay->names;
 	unsigned long	rulecofs = jay->codesz;
 	uint32_t	rulenid;
@@ -1628,6 +3196,68 @@ static inline bool _rule_decl(const struct jy_asts *asts,
 	if (jay->rulecofs == NULL)
 		goto OUT_OF_MEMORY;
 
+	jry_mem_push(jay->rulefofs, jay->rulesz, fstart);
+
+	if (jay->rulefofs == NULL)
+		goto OUT_OF_MEMORY;
+
+	unsigned long pstart = jay->pcodesz;
+
+	jry_mem_push(jay->rulepofs, jay->rulesz, pstart);
+
+	if (jay->rulepofs == NULL)
+		goto OUT_OF_MEMORY;
+
+	jry_mem_push(jay->rulereg, jay->rulesz, 0);
+
+	if (jay->rulereg == NULL)
+		goto OUT_OF_MEMORY;
+
+	jry_mem_push(jay->ruleoofs, jay->rulesz, jay->outtypesz);
+
+	if (jay->ruleoofs == NULL)
+		goto OUT_OF_MEMORY;
+
+	jry_mem_push(jay->ruleosz, jay->rulesz, 0);
+
+	if (jay->ruleosz == NULL)
+		goto OUT_OF_MEMORY;
+
+	jry_mem_push(jay->rulerofs, jay->rulesz, jay->readsz);
+
+	if (jay->rulerofs == NULL)
+		goto OUT_OF_MEMORY;
+
+	jry_mem_push(jay->rulersz, jay->rulesz, 0);
+
+	if (jay->rulersz == NULL)
+		goto OUT_OF_MEMORY;
+
+	jry_mem_push(jay->rulewhere, jay->rulesz, NULL);
+
+	if (jay->rulewhere == NULL)
+		goto OUT_OF_MEMORY;
+
+	jry_mem_push(jay->rulestack, jay->rulesz, 0);
+
+	if (jay->rulestack == NULL)
+		goto OUT_OF_MEMORY;
+
+	jry_mem_push(jay->rulebatch, jay->rulesz, 0);
+
+	if (jay->rulebatch == NULL)
+		goto OUT_OF_MEMORY;
+
+	jry_mem_push(jay->ruleact, jay->rulesz, false);
+
+	if (jay->ruleact == NULL)
+		goto OUT_OF_MEMORY;
+
+	jry_mem_push(jay->rulesuppress, jay->rulesz, 0);
+
+	if (jay->rulesuppress == NULL)
+		goto OUT_OF_MEMORY;
+
 	jry_mem_push(jay->rulenids, jay->rulesz, rulenid);
 
 	if (jay->rulenids == NULL)
@@ -1655,6 +3285,9 @@ static inline bool _rule_decl(const struct jy_asts *asts,
 		case AST_OUTPUT_SECT:
 			outputs[outputsz++] = chid;
 			break;
+		case AST_SUPPRESS_SECT:
+			sups[supsz++] = chid;
+			break;
 		default: {
 			uint32_t to = asts->tkns[chid];
 			tkn_error(errs, "invalid rule section", ruletkn, to);
@@ -1687,32 +3320,82 @@ static inline bool _rule_decl(const struct jy_asts *asts,
 		goto PANIC;
 	}
 
+	if (supsz > 1) {
+		tkn_error(errs, "too many suppress section", ruletkn, ruletkn);
+		goto PANIC;
+	}
+
 	struct compiler ctx = {
-		.names = jay->names,
-		.vals  = &jay->vals,
-		.types = &jay->types,
-		.valsz = &jay->valsz,
+		.names	 = jay->names,
+		.vals	 = &jay->vals,
+		.types	 = &jay->types,
+		.valsz	 = &jay->valsz,
+		.reads	 = &jay->reads,
+		.readsz	 = &jay->readsz,
+		.readofs = jay->readsz,
+		.foldsz	 = &jay->foldsz,
+		.sharesz = &jay->sharesz,
 	};
 
 	ctx.codes  = &jay->fcodes;
 	ctx.codesz = &jay->fcodesz;
 
+	const char *events[255];
+	uint32_t    eventsz = 0;
+
+	for (uint32_t i = 0; i < matchsz; ++i)
+		_match_events(asts, tkns, matchs[i], &eventsz, events);
+
+	// Calls that read no event are hoisted into the prologue, unless a
+	// call is left per row, it may change what the hoisted ones return.
+	uint32_t      hoists[0xff];
+	enum jy_ktype hoistts[0xff];
+	bool	      hoist = actionsz == 0;
+
+	for (uint32_t i = 0; hoist && i < condsz; ++i)
+		hoist = _hoists_calls(asts, conds[i]);
+
+	for (uint32_t i = 0; hoist && i < outputsz; ++i)
+		hoist = _hoists_calls(asts, outputs[i]);
+
+	if (hoist) {
+		ctx.pcodes  = &jay->pcodes;
+		ctx.pcodesz = &jay->pcodesz;
+		ctx.hoists  = hoists;
+		ctx.hoistts = hoistts;
+	}
+
+	bool never = false;
+
 	for (uint32_t i = 0; i < condsz; ++i) {
 		uint32_t id = conds[i];
 		_condition_sect(asts, tkns, id, &ctx, errs, &patchofs,
-				&patchsz);
+				&patchsz, eventsz, events,
+				&jay->rulewhere[view.ofs], &never);
 	}
 
 	for (uint32_t i = 0; i < outputsz; ++i) {
 		uint32_t id = outputs[i];
-		_output_sect(asts, tkns, id, &ctx, errs);
+		_output_sect(asts, tkns, id, &ctx, errs, &jay->outtypes,
+			     &jay->outtypesz);
 	}
 
+	jay->ruleosz[view.ofs] = jay->outtypesz - jay->ruleoofs[view.ofs];
+	ctx.pcodes	       = NULL;
+
 	for (uint32_t i = 0; i < actionsz; ++i) {
 		uint32_t id = actions[i];
 		_action_sect(asts, tkns, id, &ctx, errs);
 	}
 
+	jay->ruleact[view.ofs] = actionsz > 0;
+
+	for (uint32_t i = 0; i < supsz; ++i) {
+		uint32_t id = sups[i];
+		_suppress_sect(asts, tkns, id, errs,
+			       &jay->rulesuppress[view.ofs]);
+	}
+
 	// patch jumps to END
 	for (uint32_t i = 0; i < patchsz; ++i) {
 		uint32_t ofs = patchofs[i];
@@ -1722,31 +3405,41 @@ static inline bool _rule_decl(const struct jy_asts *asts,
 		memcpy(*ctx.codes + ofs, &jmp, sizeof(jmp));
 	}
 
+	// still compiled above to report its errors
+	if (never) {
+		*ctx.codesz  = fstart;
+		jay->readsz  = jay->rulerofs[view.ofs];
+		jay->pcodesz = pstart;
+		ctx.hoistsz  = 0;
+
+		jry_free(jay->rulewhere[view.ofs]);
+		jay->rulewhere[view.ofs] = NULL;
+	}
+
 	if (emit_byte(JY_OP_END, ctx.codes, ctx.codesz))
 		goto OUT_OF_MEMORY;
 
-	union jy_value	ofsv   = { .ofs = fstart };
-	uint32_t	ofskid = *ctx.valsz;
-	size_t		valsz  = *ctx.valsz;
-	union jy_value *vals   = *ctx.vals;
-	enum jy_ktype  *types  = *ctx.types;
+	if (ctx.hoistsz && emit_byte(JY_OP_END, &jay->pcodes, &jay->pcodesz))
+		goto OUT_OF_MEMORY;
 
-	for (uint32_t i = 0; i < valsz; ++i) {
-		if (types[i] != JY_K_OFS)
-			continue;
+	jay->rulereg[view.ofs]	= ctx.hoistsz;
+	jay->hoistsz	       += ctx.hoistsz;
 
-		if (vals[i].ofs == ofsv.ofs) {
-			ofskid = i;
-			goto EMIT_QUERY;
-		}
-	}
+	if (errs->size == 0
+	    && peephole(ctx.codes, ctx.codesz, fstart, jay->vals, jay->types))
+		goto OUT_OF_MEMORY;
 
-	if (emit_cnst(ofsv, JY_K_OFS, ctx.vals, ctx.types, ctx.valsz))
+	// the query finds its free chunk through the rule ordinal
+	uint32_t rulekid = *ctx.valsz;
+
+	if (emit_cnst(view, JY_K_RULE, ctx.vals, ctx.types, ctx.valsz))
 		goto OUT_OF_MEMORY;
 
-EMIT_QUERY:
+	jay->rulersz[view.ofs] = jay->readsz - jay->rulerofs[view.ofs];
+
 	ctx.codes  = &jay->codes;
 	ctx.codesz = &jay->codesz;
+	ctx.reads  = NULL;
 
 	long qlen = 0;
 
@@ -1764,13 +3457,63 @@ EMIT_QUERY:
 		_match_sect(asts, tkns, id, &ctx, errs);
 	}
 
-	if (emit_query(ctx.valsz, ctx.vals, ctx.types, ctx.codesz, ctx.codes,
-		       qlen, ofskid))
+	if (never) {
+		uint16_t nid = rulenid;
+
+		*ctx.codesz = rulecofs;
+
+		jry_mem_push(jay->deadnids, jay->deadsz, nid);
+
+		if (jay->deadnids == NULL)
+			goto OUT_OF_MEMORY;
+
+		jay->deadsz += 1;
+	} else if (emit_query(ctx.valsz, ctx.vals, ctx.types, ctx.codesz,
+			      ctx.codes, qlen, rulekid)) {
 		goto OUT_OF_MEMORY;
+	}
 
 	if (emit_byte(JY_OP_END, ctx.codes, ctx.codesz) != 0)
 		return true;
 
+	if (errs->size)
+		goto FINISH;
+
+	// the free chunk and its prologue run once QUERY popped the main
+	// chunk stack, the prologue types the registers
+	uint32_t      mdepth;
+	uint32_t      fdepth;
+	uint32_t      pdepth = 0;
+	uint32_t      regsz  = ctx.hoistsz;
+	enum jy_ktype regt[0xff];
+
+	for (uint32_t i = 0; i < regsz; ++i)
+		regt[i] = JY_K_UNKNOWN;
+
+	if (verify_chunk(jay->codes + rulecofs, jay->codesz - rulecofs,
+			 jay->vals, jay->types, jay->valsz, NULL, 0, &mdepth)
+	    || (regsz
+		&& verify_chunk(jay->pcodes + pstart, jay->pcodesz - pstart,
+				jay->vals, jay->types, jay->valsz, regt, regsz,
+				&pdepth))
+	    || verify_chunk(jay->fcodes + fstart, jay->fcodesz - fstart,
+			    jay->vals, jay->types, jay->valsz, regt, regsz,
+			    &fdepth)) {
+		tkn_error(errs, "rule failed bytecode verification", ruletkn,
+			  ruletkn);
+		goto PANIC;
+	}
+
+	uint32_t depth = mdepth > fdepth ? mdepth : fdepth;
+	depth	       = pdepth > depth ? pdepth : depth;
+
+	jay->rulestack[view.ofs] = depth;
+	jay->rulebatch[view.ofs] = batch_prefix(jay->fcodes + fstart, jay->vals,
+						jay->types, jay->valsz);
+
+	if (depth > jay->stackmax)
+		jay->stackmax = depth;
+
 	goto FINISH;
 
 PANIC:
@@ -1846,6 +3589,10 @@ static inline bool _ingress_decl(struct sc_mem	      *alloc,
 	if (def_add(v.def, "__arrival__", null, JY_K_LONG))
 		goto PANIC;
 
+	// monotonic nanoseconds of jary_event(), see jary_latency()
+	if (def_add(v.def, "__ingest__", null, JY_K_LONG))
+		goto PANIC;
+
 	for (uint32_t i = 0; i < fieldsz; ++i)
 		if (_field_sect(asts, tkns, errs, fields[i], v.def))
 			goto PANIC;
@@ -1976,7 +3723,8 @@ static void free_jay(struct jy_jay *ctx)
 
 		switch (ctx->types[i]) {
 		case JY_K_STR:
-			jry_free(v.str);
+			if (!ctx->interned)
+				jry_free(v.str);
 			break;
 		default:
 			continue;
@@ -1985,10 +3733,29 @@ static void free_jay(struct jy_jay *ctx)
 
 	jry_free(ctx->codes);
 	jry_free(ctx->fcodes);
+	jry_free(ctx->pcodes);
 	jry_free(ctx->vals);
 	jry_free(ctx->types);
 	jry_free(ctx->rulenids);
 	jry_free(ctx->rulecofs);
+	jry_free(ctx->rulefofs);
+	jry_free(ctx->rulepofs);
+	jry_free(ctx->rulereg);
+	jry_free(ctx->ruleoofs);
+	jry_free(ctx->ruleosz);
+	jry_free(ctx->outtypes);
+	for (uint32_t i = 0; ctx->rulewhere && i < ctx->rulesz; ++i)
+		jry_free(ctx->rulewhere[i]);
+
+	jry_free(ctx->rulewhere);
+	jry_free(ctx->rulestack);
+	jry_free(ctx->rulebatch);
+	jry_free(ctx->ruleact);
+	jry_free(ctx->rulesuppress);
+	jry_free(ctx->rulerofs);
+	jry_free(ctx->rulersz);
+	jry_free(ctx->reads);
+	jry_free(ctx->deadnids);
 
 	for (uint32_t i = 0; i < ctx->names->capacity; ++i) {
 		union jy_value v    = ctx->names->vals[i];
@@ -34,6 +34,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "jary/types.h"
 
+#include <stdbool.h>
 #include <stdint.h>
 
 struct sc_mem;
@@ -44,6 +45,11 @@ struct tkn_errs;
 enum jy_opcode {
 	JY_OP_PUSH8,
 	JY_OP_PUSH16,
+	// copy of a stack slot counted from the chunk bottom
+	JY_OP_DUP,
+	// rule register set by the prologue, read by the free chunk
+	JY_OP_SETR,
+	JY_OP_GETR,
 
 	JY_OP_SETBF8,
 
@@ -53,6 +59,7 @@ enum jy_opcode {
 	JY_OP_JMPT,
 	JY_OP_JMPF,
 	JY_OP_CALL,
+	JY_OP_CALLV,
 
 	JY_OP_QUERY,
 	JY_OP_REGEX,
@@ -67,31 +74,108 @@ enum jy_opcode {
 	JY_OP_GT,
 
 	JY_OP_ADD,
-	JY_OP_CONCAT,
+	JY_OP_CONCATN,
 	JY_OP_SUB,
 	JY_OP_MUL,
 	JY_OP_DIV,
 
+	// event field compared with a constant, fused by the peephole pass
+	JY_OP_CMPSTR_FK,
+	JY_OP_CMP_FK,
+	JY_OP_LT_FK,
+	JY_OP_GT_FK,
+
 	JY_OP_END
 };
 
+// instruction length in bytes, operands included
+static inline uint32_t jry_oplen(enum jy_opcode code)
+{
+	switch (code) {
+	case JY_OP_PUSH8:
+	case JY_OP_DUP:
+	case JY_OP_SETR:
+	case JY_OP_GETR:
+	case JY_OP_CALL:
+	case JY_OP_CALLV:
+	case JY_OP_CONCATN:
+		return 2;
+	case JY_OP_PUSH16:
+	case JY_OP_JMPF:
+	case JY_OP_JMPT:
+		return 3;
+	case JY_OP_CMPSTR_FK:
+	case JY_OP_CMP_FK:
+	case JY_OP_LT_FK:
+	case JY_OP_GT_FK:
+		return 5;
+	default:
+		return 1;
+	}
+}
+
 struct jy_jay {
 	// global names
 	struct jy_defs *names;
 	uint8_t	       *codes;
 	uint8_t	       *fcodes;
+	// row invariant part of the free chunks, run once per query
+	uint8_t	       *pcodes;
 
 	// rule offset within the main chunk;
 	uint32_t       *rulecofs;
+	// rule offset within the free chunk;
+	uint32_t       *rulefofs;
+	// rule offset within the prologue chunk;
+	uint32_t       *rulepofs;
+	// rule registers set by its prologue, 0 if it has none
+	uint16_t       *rulereg;
+	// rule output types start within outtypes;
+	uint32_t       *ruleoofs;
 	// rule ordinal from the name table;
 	uint16_t       *rulenids;
+	// rule output length;
+	uint16_t       *ruleosz;
+	// output value types of every rule
+	enum jy_ktype  *outtypes;
+	// rule loaded fields start within reads;
+	uint32_t       *rulerofs;
+	// rule loaded fields length;
+	uint16_t       *rulersz;
+	// event fields loaded by every rule free chunk
+	struct jy_desc *reads;
+	// rule conditions evaluated by the query, NULL if none
+	char	      **rulewhere;
+	// rule maximum stack depth;
+	uint16_t       *rulestack;
+	// free chunk bytes evaluated over a batch of rows, 0 if none
+	uint16_t       *rulebatch;
+	// rule has an action section, it runs without any callback
+	bool	       *ruleact;
+	// seconds a rule output is suppressed once seen, 0 if never
+	uint32_t       *rulesuppress;
 	// constant table
 	union jy_value *vals;
 	enum jy_ktype  *types;
 	uint32_t	codesz;
 	uint32_t	fcodesz;
+	uint32_t	pcodesz;
+	uint32_t	outtypesz;
+	uint32_t	readsz;
+	// rules whose condition is never true, by name ordinal
+	uint16_t       *deadnids;
+	// deepest stack of every rule
+	uint32_t	stackmax;
+	// literal expressions folded, output expressions shared and row
+	// invariant expressions hoisted
+	uint32_t	foldsz;
+	uint32_t	sharesz;
+	uint32_t	hoistsz;
 	uint16_t	valsz;
 	uint16_t	rulesz;
+	uint16_t	deadsz;
+	// string constants moved to an intern table, see jry_intern_pool()
+	bool		interned;
 };
 
 int jry_compile(struct sc_mem	     *alloc,
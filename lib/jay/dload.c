@@ -39,6 +39,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "jary/defs.h"
 #include "jary/memory.h"
+#include "jary/native.h"
 
 #include <assert.h>
 #include <stdint.h>
@@ -164,6 +165,60 @@ FINISH:
 	return status;
 }
 
+int jry_dlnative(const char	       *path,
+		 uint64_t		 hash,
+		 uint32_t		 rulesz,
+		 void		       **handle,
+		 jy_native_rule *const **rules,
+		 const char	       **msg)
+{
+	int ret = 0;
+
+	*handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+
+	if (*handle == NULL)
+		goto DLOAD_ERROR;
+
+	const unsigned int	 *abi	= dlsym(*handle, "jary_native_abi");
+	const unsigned long long *khash = dlsym(*handle, "jary_native_hash");
+	const unsigned int	 *ksz	= dlsym(*handle, "jary_native_rulesz");
+
+	*rules = dlsym(*handle, "jary_native_rules");
+
+	if (abi == NULL || khash == NULL || ksz == NULL || *rules == NULL)
+		goto DLOAD_ERROR;
+
+	if (*abi != JY_NATIVE_ABI || *khash != hash || *ksz != rulesz)
+		goto MISMATCH;
+
+	goto FINISH;
+
+MISMATCH:
+	*msg = "native ruleset was built from different rules";
+	ret  = 4;
+	goto CLOSE;
+
+DLOAD_ERROR:
+	*msg = dlerror();
+	ret  = 3;
+
+CLOSE:
+	if (*handle != NULL)
+		dlclose(*handle);
+
+	*handle = NULL;
+	*rules	= NULL;
+
+FINISH:
+	return ret;
+}
+
+void jry_dlclose(void *handle)
+{
+	if (handle != NULL)
+		dlclose(handle);
+}
+
 #endif // __unix__
 
 // > user modules API
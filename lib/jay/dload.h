@@ -32,10 +32,25 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef JAYVM_DLOAD_H
 #define JAYVM_DLOAD_H
 
+#include "jary/native.h"
+
+#include <stdint.h>
+
 struct jy_defs;
 
 int jry_dlload(const char *path, struct jy_defs *def, const char **errmsg);
 
 int jry_dlunload(struct jy_defs *def, const char **errmsg);
 
+// Open a ruleset built from jry_emit_c() output. Fails with 4 when it was
+// built from rules other than the ones hash and rulesz describe.
+int jry_dlnative(const char	       *path,
+		 uint64_t		 hash,
+		 uint32_t		 rulesz,
+		 void		       **handle,
+		 jy_native_rule *const **rules,
+		 const char	       **msg);
+
+void jry_dlclose(void *handle);
+
 #endif // JAYVM_DLOAD_H
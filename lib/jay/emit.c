@@ -0,0 +1,395 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2024. Muhammad Raznan. All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "emit.h"
+
+#include "compiler.h"
+
+#include "jary/defs.h"
+#include "jary/types.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#define SIZE()	   bufsz ? bufsz - sz : 0
+#define PTR()	   sz ? buf + sz : buf
+#define EMIT(...)  sz += snprintf(PTR(), SIZE(), __VA_ARGS__)
+
+// C expression of the long constant k, LONG_MIN has no literal
+static inline int prlong(int bufsz, char *buf, long value)
+{
+	int sz = 0;
+
+	if (value == -9223372036854775807L - 1)
+		EMIT("(-9223372036854775807L - 1)");
+	else
+		EMIT("%ldL", value);
+
+	return sz;
+}
+
+// C expression of the event field the descriptor k points to
+static inline int prfield(int bufsz, char *buf, const union jy_value *vals,
+			  uint32_t k)
+{
+	int	       sz = 0;
+	struct jy_desc d  = vals[k].dscptr;
+
+	EMIT("vals[%u].def->vals[%u]", d.name, d.member);
+
+	return sz;
+}
+
+static int prrule(int			bufsz,
+		  char		       *buf,
+		  const struct jy_jay *jay,
+		  uint32_t		rule)
+{
+	int		      sz     = 0;
+	const union jy_value *vals   = jay->vals;
+	const enum jy_ktype  *types  = jay->types;
+	const uint8_t	     *codes  = jay->fcodes + jay->rulefofs[rule];
+	uint32_t	      len    = 0;
+
+	while (codes[len] != JY_OP_END)
+		len += jry_oplen(codes[len]);
+
+	// jump targets get a label, constants are kept for OUTPUT
+	bool	 target[len + 1];
+	uint32_t kslot[jay->rulestack[rule] + 1];
+	uint32_t d = 0;
+
+	memset(target, 0, sizeof(target));
+
+	for (uint32_t pc = 0; pc < len; pc += jry_oplen(codes[pc])) {
+		if (codes[pc] != JY_OP_JMPF && codes[pc] != JY_OP_JMPT)
+			continue;
+
+		int16_t off;
+		memcpy(&off, codes + pc + 1, sizeof(off));
+		target[pc + off] = true;
+	}
+
+	EMIT("// rule %s\n", jay->names->keys[jay->rulenids[rule]]);
+	EMIT("static int rule_%u(const union jy_value *vals,\n"
+	     "\t\t  const struct jy_native *rt)\n"
+	     "{\n",
+	     rule);
+	EMIT("\tunion jy_value s[%u];\n", jay->rulestack[rule] + 1);
+	EMIT("\tbool\t       flag = false;\n\n");
+	EMIT("\t(void) vals;\n\t(void) rt;\n\t(void) s;\n\t(void) flag;\n\n");
+
+	for (uint32_t pc = 0; pc <= len;) {
+		const uint8_t *op = codes + pc;
+
+		if (target[pc])
+			EMIT("L%u:\n", pc);
+
+		switch (*op) {
+		case JY_OP_PUSH8:
+		case JY_OP_PUSH16: {
+			uint32_t k    = op[1];
+			uint32_t next = pc + jry_oplen(*op);
+
+			if (*op == JY_OP_PUSH16)
+				k |= op[2] << 8;
+
+			kslot[d] = k;
+
+			if (types[k] == JY_K_DESCRIPTOR
+			    && codes[next] == JY_OP_LOAD && !target[next]) {
+				EMIT("\ts[%u] = ", d++);
+				sz += prfield(SIZE(), PTR(), vals, k);
+				EMIT(";\n");
+				pc = next + 1;
+				continue;
+			}
+
+			if (types[k] == JY_K_LONG) {
+				EMIT("\ts[%u].i64 = ", d++);
+				sz += prlong(SIZE(), PTR(), vals[k].i64);
+				EMIT(";\n");
+			} else {
+				EMIT("\ts[%u] = vals[%u];\n", d++, k);
+			}
+			break;
+		}
+		case JY_OP_GETR:
+			kslot[d] = -1u;
+			EMIT("\ts[%u] = rt->regs[%u];\n", d++, op[1]);
+			break;
+		case JY_OP_DUP:
+			kslot[d] = kslot[op[1]];
+			EMIT("\ts[%u] = s[%u];\n", d++, op[1]);
+			break;
+		case JY_OP_LOAD:
+			EMIT("\ts[%u] = vals[s[%u].dscptr.name]"
+			     ".def->vals[s[%u].dscptr.member];\n",
+			     d - 1, d - 1, d - 1);
+			break;
+		case JY_OP_CALL:
+		case JY_OP_CALLV: {
+			uint32_t n = op[1];
+			uint32_t f = d - n - 1;
+
+			EMIT("\t{\n\t\tunion jy_value a[%u] = {", n ? n : 1);
+
+			// the callee takes its arguments last pushed first
+			for (uint32_t i = 0; i < n; ++i)
+				EMIT(" s[%u],", d - 1 - i);
+
+			EMIT(" };\n\t\tunion jy_value r;\n\n");
+			EMIT("\t\ts[%u].func->func(rt->state, %u, a, &r);\n",
+			     f, n);
+
+			if (*op == JY_OP_CALL)
+				EMIT("\t\ts[%u] = r;\n", f);
+
+			EMIT("\t}\n");
+
+			d = *op == JY_OP_CALL ? f + 1 : f;
+			break;
+		}
+		case JY_OP_OUTPUT: {
+			uint32_t n = vals[kslot[d - 1]].u64;
+
+			d -= n + 1;
+
+			EMIT("\tif (rt->output(rt, &s[%u], %u))\n"
+			     "\t\treturn 1;\n",
+			     d, n);
+			break;
+		}
+		case JY_OP_JMPF:
+		case JY_OP_JMPT: {
+			int16_t off;
+			memcpy(&off, op + 1, sizeof(off));
+
+			EMIT("\tif (%sflag)\n\t\tgoto L%u;\n",
+			     *op == JY_OP_JMPF ? "!" : "", pc + off);
+			break;
+		}
+		case JY_OP_NOT:
+			EMIT("\tflag = !flag;\n");
+			break;
+		case JY_OP_SETBF8:
+			EMIT("\tflag = s[%u].i64;\n", --d);
+			break;
+		case JY_OP_CMPSTR:
+			d -= 2;
+			EMIT("\tflag = streq(s[%u].str, s[%u].str);\n", d,
+			     d + 1);
+			break;
+		case JY_OP_CMP:
+		case JY_OP_LT:
+		case JY_OP_GT: {
+			const char *cmp = *op == JY_OP_CMP ? "=="
+					: *op == JY_OP_LT  ? "<"
+							   : ">";
+			d -= 2;
+			EMIT("\tflag = s[%u].i64 %s s[%u].i64;\n", d, cmp,
+			     d + 1);
+			break;
+		}
+		case JY_OP_CMPSTR_FK:
+		case JY_OP_CMP_FK:
+		case JY_OP_LT_FK:
+		case JY_OP_GT_FK: {
+			uint32_t desc = op[1] | op[2] << 8;
+			uint32_t k    = op[3] | op[4] << 8;
+
+			EMIT("\tflag = ");
+
+			if (*op == JY_OP_CMPSTR_FK) {
+				EMIT("streq(");
+				sz += prfield(SIZE(), PTR(), vals, desc);
+				EMIT(".str, vals[%u].str);\n", k);
+				break;
+			}
+
+			const char *cmp = *op == JY_OP_CMP_FK ? "=="
+					: *op == JY_OP_LT_FK  ? "<"
+							      : ">";
+
+			sz += prfield(SIZE(), PTR(), vals, desc);
+			EMIT(".i64 %s ", cmp);
+			sz += prlong(SIZE(), PTR(), vals[k].i64);
+			EMIT(";\n");
+			break;
+		}
+		case JY_OP_ADD:
+		case JY_OP_SUB:
+		case JY_OP_MUL:
+		case JY_OP_DIV: {
+			const char *arith = *op == JY_OP_ADD   ? "+="
+					  : *op == JY_OP_SUB ? "-="
+					  : *op == JY_OP_MUL ? "*="
+							     : "/=";
+			d -= 1;
+			EMIT("\ts[%u].i64 %s s[%u].i64;\n", d - 1, arith, d);
+			break;
+		}
+		case JY_OP_CONCATN:
+			d -= op[1] - 1;
+			EMIT("\ts[%u].str = rt->concat(rt->state, &s[%u], "
+			     "%u);\n\tif (s[%u].str == NULL)\n\t\treturn 1;\n",
+			     d - 1, d - 1, op[1], d - 1);
+			break;
+		case JY_OP_END:
+			EMIT("\treturn 0;\n");
+			break;
+		default:
+			// match opcodes never reach a free chunk
+			EMIT("\treturn 1;\n");
+			break;
+		}
+
+		pc += jry_oplen(*op);
+	}
+
+	EMIT("}\n\n");
+
+	return sz;
+}
+
+int jry_emit_c(int bufsz, char *buf, const struct jy_jay *jay)
+{
+	int sz = 0;
+
+	EMIT("// generated by jassy --emit-c, do not edit\n\n"
+	     "#include <jary/native.h>\n\n");
+	EMIT("static inline bool streq(const struct jy_str *a,\n"
+	     "\t\t\t const struct jy_str *b)\n"
+	     "{\n"
+	     "\treturn a == b\n"
+	     "\t    || (a->size == b->size\n"
+	     "\t\t&& memcmp(a->cstr, b->cstr, a->size) == 0);\n"
+	     "}\n\n");
+
+	for (uint32_t i = 0; i < jay->rulesz; ++i)
+		sz += prrule(SIZE(), PTR(), jay, i);
+
+	EMIT("const unsigned int jary_native_abi = JY_NATIVE_ABI;\n");
+	EMIT("const unsigned long long jary_native_hash = 0x%016llxULL;\n",
+	     (unsigned long long) jry_hash(jay));
+	EMIT("const unsigned int jary_native_rulesz = %u;\n", jay->rulesz);
+	EMIT("jy_native_rule *const jary_native_rules[] = {\n");
+
+	for (uint32_t i = 0; i < jay->rulesz; ++i)
+		EMIT("\trule_%u,\n", i);
+
+	if (jay->rulesz == 0)
+		EMIT("\t0,\n");
+
+	EMIT("};\n");
+
+	return sz;
+}
+
+#undef EMIT
+#undef PTR
+#undef SIZE
+
+// FNV-1a
+static inline uint64_t mix(uint64_t h, const void *data, size_t size)
+{
+	const unsigned char *p = data;
+
+	for (size_t i = 0; i < size; ++i) {
+		h ^= p[i];
+		h *= 0x100000001b3ULL;
+	}
+
+	return h;
+}
+
+static inline uint64_t mixdef(uint64_t h, const struct jy_defs *def)
+{
+	for (uint32_t i = 0; i < def->capacity; ++i) {
+		const char *key = def->keys[i];
+
+		if (key == NULL)
+			continue;
+
+		h = mix(h, &i, sizeof(i));
+		h = mix(h, key, strlen(key));
+		h = mix(h, &def->types[i], sizeof(def->types[i]));
+	}
+
+	return h;
+}
+
+uint64_t jry_hash(const struct jy_jay *jay)
+{
+	uint64_t h = 0xcbf29ce484222325ULL;
+
+	h = mix(h, &jay->rulesz, sizeof(jay->rulesz));
+	h = mix(h, jay->codes, jay->codesz);
+	h = mix(h, jay->fcodes, jay->fcodesz);
+	h = mix(h, jay->pcodes, jay->pcodesz);
+	h = mix(h, jay->rulereg, sizeof(*jay->rulereg) * jay->rulesz);
+	h = mix(h, jay->outtypes, sizeof(*jay->outtypes) * jay->outtypesz);
+	h = mix(h, jay->rulefofs, sizeof(*jay->rulefofs) * jay->rulesz);
+	h = mix(h, jay->types, sizeof(*jay->types) * jay->valsz);
+
+	// pointers differ between runs, their contents do not
+	for (uint32_t i = 0; i < jay->valsz; ++i) {
+		union jy_value v = jay->vals[i];
+
+		switch (jay->types[i]) {
+		case JY_K_LONG:
+		case JY_K_ULONG:
+		case JY_K_BOOL:
+		case JY_K_RULE:
+			h = mix(h, &v.u64, sizeof(v.u64));
+			break;
+		case JY_K_STR:
+		case JY_K_REGEX:
+			h = mix(h, v.str->cstr, v.str->size);
+			break;
+		case JY_K_DESCRIPTOR:
+			h = mix(h, &v.dscptr, sizeof(v.dscptr));
+			break;
+		case JY_K_TIME:
+			h = mix(h, &v.timeofs, sizeof(v.timeofs));
+			break;
+		case JY_K_EVENT:
+		case JY_K_MODULE:
+			h = mixdef(h, v.def);
+			break;
+		default:
+			break;
+		}
+	}
+
+	return h;
+}
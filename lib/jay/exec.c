@@ -36,39 +36,60 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "jary/defs.h"
 #include "jary/memory.h"
+#include "jary/native.h"
 #include "jary/types.h"
 
 #include <assert.h>
-#include <errno.h>
 #include <sqlite3.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
 
-union flag8 {
-	uint8_t flag;
-
-	struct bits {
-		bool b1 : 1;
-		bool b2 : 1;
-		bool b3 : 1;
-		bool b4 : 1;
-		bool b5 : 1;
-		bool b6 : 1;
-		bool b7 : 1;
-		bool b8 : 1;
-	} bits;
-};
-
-struct stack {
-	union jy_value *values;
-	struct sb_mem	m;
+// computed goto is a GNU extension, everything else gets a switch
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(JRY_SWITCH_DISPATCH)
+#define THREADED
+#endif
+
+// rows buffered before the batch part of a free chunk runs over them
+#define BATCHSZ 1024
+
+// SQLite instructions between two checks of the rule deadline
+#define PROGRESSOPS 4096
+
+struct batch {
+	// column major values of the buffered rows, a string is either
+	// interned or the offset of its copy in the row arena tagged with
+	// the low bit
+	union jy_value	      *cells;
+	// one scratch vector per stack slot
+	union jy_value	      *vstack;
+	const union jy_value **slot;
+	// free chunk bytes evaluated over the whole batch
+	uint32_t	       prefix;
+	uint32_t	       size;
+	uint32_t	       selsz;
+	uint16_t	       sel[BATCHSZ];
+	bool		       mask[BATCHSZ];
+	// newest __ingest__ of every row, see jy_state.latency
+	uint64_t	       ingest[BATCHSZ];
 };
 
 struct match_data {
 	struct jy_defs	     *names;
 	const uint8_t	     *codes;
 	const union jy_value *vals;
+	const enum jy_ktype  *otypes;
+	// string columns of the current row, or of the whole batch
+	struct sb_mem	     *row;
+	// free part of the VM stack
+	union jy_value	     *stack;
+	// NULL when the rows run one by one
+	struct batch	     *batch;
+	// native free chunk, runs instead of codes when set
+	jy_native_rule	       *native;
+	const struct jy_native *rt;
+	// registers set by the rule prologue
+	union jy_value	       *regs;
 	struct jy_state *restrict state;
 };
 
@@ -76,649 +97,1416 @@ struct match_data {
 struct runtime {
 	// runtime memory scratch
 	struct sc_mem buf;
-	struct stack  stack;
 	struct sqlite3 *restrict db;
 	const union jy_value *vals;
 	struct jy_defs	     *names;
-	const uint8_t	    **pc;
 	const uint8_t	     *fcodes;
-	union flag8	      flag;
+	const struct jy_jay  *jay;
+	// output types of the rule being matched
+	const enum jy_ktype  *otypes;
+	// when set, queries are explained instead of executed
+	char		    **plan;
+	union jy_value	     *stack;
+	union jy_value	     *regs;
 };
 
-static inline int interpret(struct runtime *ctx,
-			    struct jy_state *restrict state);
+static int interpret(struct runtime *ctx,
+		     const uint8_t  *codes,
+		     struct jy_state *restrict state);
 
 static inline void free_runtime(struct runtime *restrict ctx)
 {
-	sb_free(&ctx->stack.m);
 	sc_free(&ctx->buf);
 }
 
-static inline bool push(struct stack *s, union jy_value value)
+// size of a row string, aligned for the next one
+static inline uint32_t rowstrsz(uint32_t len)
+{
+	uint32_t align = _Alignof(struct jy_str);
+	uint32_t sz    = sizeof(struct jy_str) + len + 1;
+
+	return (sz + align - 1) & ~(align - 1);
+}
+
+#define INTERNSLOTS 4096
+#define INTERNARENA (128 * 1024)
+
+static inline uint32_t strhash(const char *str, uint32_t len)
+{
+	uint32_t h = 2166136261u;
+
+	for (uint32_t i = 0; i < len; ++i)
+		h = (h ^ (uint8_t) str[i]) * 16777619u;
+
+	return h;
+}
+
+// slot holding str, or the empty one it goes to
+static uint32_t intern_slot(const struct jy_intern *t,
+			    uint32_t		     h,
+			    const char		    *str,
+			    uint32_t		     len)
 {
-	uint32_t idx = s->m.size / sizeof(value);
-	void	*mem = sb_alloc(&s->m, 0, sizeof(value));
+	uint32_t mask = INTERNSLOTS - 1;
+	uint32_t i    = h & mask;
 
-	if (mem == NULL)
+	for (;; i = (i + 1) & mask) {
+		uint64_t e = t->slots[i];
+
+		if (e == 0)
+			break;
+
+		if ((uint32_t) (e >> 32) != h)
+			continue;
+
+		const struct jy_str *s = (void *) (t->arena + (uint32_t) e - 1);
+
+		if (s->size == len && memcmp(s->cstr, str, len) == 0)
+			break;
+	}
+
+	return i;
+}
+
+static struct jy_str *intern(struct jy_intern *t, const char *str, uint32_t len)
+{
+	if (t->arena == NULL) {
+		t->arena = jry_alloc(INTERNARENA);
+		t->slots = jry_alloc(sizeof(*t->slots) * INTERNSLOTS);
+
+		if (t->arena == NULL || t->slots == NULL) {
+			jry_intern_free(t);
+			return NULL;
+		}
+
+		memset(t->slots, 0, sizeof(*t->slots) * INTERNSLOTS);
+	}
+
+	uint32_t h = strhash(str, len);
+	uint32_t i = intern_slot(t, h, str, len);
+
+	if (t->slots[i])
+		return (void *) (t->arena + (uint32_t) t->slots[i] - 1);
+
+	uint32_t sz = rowstrsz(len);
+
+	// three quarters load keeps the probes short
+	if (t->entsz >= INTERNSLOTS / 4 * 3 || t->arenasz + sz > INTERNARENA) {
+		t->full = true;
+		return NULL;
+	}
+
+	struct jy_str *s = (void *) (t->arena + t->arenasz);
+
+	s->size = len;
+	memcpy(s->cstr, str, len);
+	s->cstr[len] = '\0';
+
+	t->slots[i]   = (uint64_t) h << 32 | (t->arenasz + 1);
+	t->arenasz   += sz;
+	t->entsz     += 1;
+
+	return s;
+}
+
+struct jy_str *jry_intern(struct jy_intern *t, const char *str, uint32_t len)
+{
+	if (t == NULL || len > JRY_INTERNLEN)
+		return NULL;
+
+	return intern(t, str, len);
+}
+
+void jry_intern_pool(struct jy_intern *t, struct jy_jay *jay)
+{
+	uint32_t arenasz = 0;
+	uint32_t entsz	 = 0;
+
+	jry_intern_reset(t, true);
+
+	for (uint32_t i = 0; i < jay->valsz; ++i) {
+		if (jay->types[i] != JY_K_STR)
+			continue;
+
+		arenasz += rowstrsz(jay->vals[i].str->size);
+		entsz	+= 1;
+	}
+
+	// all or nothing, jay frees its strings unless every one moved
+	if (arenasz > INTERNARENA / 2 || entsz > INTERNSLOTS / 4)
+		return;
+
+	// the arena is only allocated by the first string
+	if (entsz && intern(t, "", 0) == NULL)
+		return;
+
+	for (uint32_t i = 0; i < jay->valsz; ++i) {
+		if (jay->types[i] != JY_K_STR)
+			continue;
+
+		struct jy_str *str = jay->vals[i].str;
+
+		jay->vals[i].str = intern(t, str->cstr, str->size);
+		jry_free(str);
+	}
+
+	jay->interned = entsz > 0;
+	t->keepsz     = t->arenasz;
+}
+
+void jry_intern_reset(struct jy_intern *t, bool all)
+{
+	if (t->arena == NULL)
+		return;
+
+	if (all)
+		t->keepsz = 0;
+
+	memset(t->slots, 0, sizeof(*t->slots) * INTERNSLOTS);
+
+	t->arenasz = 0;
+	t->entsz   = 0;
+	t->full	   = false;
+
+	// the kept strings start the arena, they go back in the same place
+	while (t->arenasz < t->keepsz) {
+		const struct jy_str *s = (void *) (t->arena + t->arenasz);
+		uint32_t	     h = strhash(s->cstr, s->size);
+		uint32_t	     i = intern_slot(t, h, s->cstr, s->size);
+
+		t->slots[i]   = (uint64_t) h << 32 | (t->arenasz + 1);
+		t->arenasz   += rowstrsz(s->size);
+		t->entsz     += 1;
+	}
+}
+
+void jry_intern_free(struct jy_intern *t)
+{
+	jry_free(t->arena);
+	jry_free(t->slots);
+
+	*t = (struct jy_intern) { .arena = NULL };
+}
+
+// equal interned strings are the same pointer, the bytes are only
+// compared when one side was not interned
+static inline bool streq(const struct jy_intern *t,
+			 const struct jy_str	*v1,
+			 const struct jy_str	*v2)
+{
+	if (v1 == v2)
 		return true;
 
-	s->values      = mem;
-	s->values[idx] = value;
+	if (jry_interned(t, v1) && jry_interned(t, v2))
+		return false;
 
-	return false;
+	return v1->size == v2->size
+	    && memcmp(v1->cstr, v2->cstr, v1->size) == 0;
 }
 
-static inline union jy_value pop(struct stack *s)
+static struct batch *batch_new(uint32_t prefix, uint32_t depth)
 {
-	uint32_t idx = s->m.size / sizeof(*s->values);
-	assert(idx > 0);
+	struct batch *b = jry_alloc(sizeof(*b));
+
+	if (b == NULL)
+		return NULL;
+
+	b->cells  = NULL;
+	b->vstack = jry_alloc(sizeof(*b->vstack) * BATCHSZ * depth);
+	b->slot	  = jry_alloc(sizeof(*b->slot) * depth);
+	b->prefix = prefix;
+	b->size	  = 0;
+
+	if (b->vstack == NULL || b->slot == NULL) {
+		jry_free(b->vstack);
+		jry_free(b->slot);
+		jry_free(b);
+		return NULL;
+	}
+
+	return b;
+}
 
-	s->m.size -= sizeof(*s->values);
+static void batch_free(struct batch *b)
+{
+	if (b == NULL)
+		return;
 
-	return s->values[--idx];
+	jry_free(b->cells);
+	jry_free(b->vstack);
+	jry_free(b->slot);
+	jry_free(b);
 }
 
-// Convert C string to value
-static inline int value_from_cstr(struct sc_mem	 *alloc,
-				  union jy_value *value,
-				  enum jy_ktype	  type,
-				  const char	 *str)
+// cells of the column holding the field d, NULL if the query skipped it
+static inline union jy_value *batch_column(struct batch		*b,
+					   const union jy_value *vals,
+					   uint32_t		 d,
+					   int			 colsz,
+					   const struct Qcol	*cols)
 {
-	switch (type) {
-	case JY_K_STR: {
-		struct jy_str *ostr;
-		uint32_t       sz = 0;
+	struct jy_desc	desc  = vals[d].dscptr;
+	struct jy_defs *event = vals[desc.name].def;
 
-		if (str != NULL)
-			sz = strlen(str);
+	for (int i = 0; i < colsz; ++i)
+		if (cols[i].event == event && cols[i].member == desc.member)
+			return b->cells + i * BATCHSZ;
 
-		// +1 to include '\0'
-		ostr = sc_alloc(alloc, sizeof(*ostr) + sz + 1);
+	return NULL;
+}
 
-		if (ostr == NULL)
-			goto OUT_OF_MEMORY;
+// Runs the batch prefix of codes over every buffered row and leaves the
+// rows passing it in the selection vector. The loops have no branches
+// on row data so the compiler turns them into SIMD. Every instruction
+// counts once per row against the ops budget. Returns false when a
+// field the prefix reads is not a query column.
+static bool batch_filter(struct batch	      *b,
+			 const uint8_t	      *codes,
+			 const union jy_value *vals,
+			 int		       colsz,
+			 const struct Qcol    *cols,
+			 uint64_t	      *ops)
+{
+	uint32_t n   = b->size;
+	uint32_t top = 0;
+	uint64_t run = 0;
+	bool	*m   = b->mask;
+
+	b->selsz = n;
+
+	for (uint32_t i = 0; i < n; ++i)
+		b->sel[i] = i;
 
-		ostr->size = sz;
-		memcpy(ostr->cstr, str, sz);
-		value->str = ostr;
-		break;
+	for (uint32_t pc = 0; pc < b->prefix; run += 1) {
+		const uint8_t *op = codes + pc;
+
+		switch (*op) {
+		case JY_OP_PUSH8:
+		case JY_OP_PUSH16: {
+			uint32_t len = *op == JY_OP_PUSH8 ? 2 : 3;
+			uint32_t k   = *op == JY_OP_PUSH8
+					     ? op[1]
+					     : *(const uint16_t *) (op + 1);
+
+			// a descriptor is always loaded right away
+			if (op[len] == JY_OP_LOAD) {
+				b->slot[top] = batch_column(b, vals, k, colsz,
+							    cols);
+
+				if (b->slot[top++] == NULL)
+					return false;
+
+				pc  += len + 1;
+				run += 1;
+				break;
+			}
+
+			union jy_value *v = b->vstack + top * BATCHSZ;
+
+			for (uint32_t i = 0; i < n; ++i)
+				v[i] = vals[k];
+
+			b->slot[top++]	= v;
+			pc	       += len;
+			break;
+		}
+		case JY_OP_CMP_FK:
+		case JY_OP_LT_FK:
+		case JY_OP_GT_FK: {
+			const union jy_value *x;
+			long		      k;
+
+			x = batch_column(b, vals, *(const uint16_t *) (op + 1),
+					 colsz, cols);
+			k = vals[*(const uint16_t *) (op + 3)].i64;
+
+			if (x == NULL)
+				return false;
+
+			if (*op == JY_OP_CMP_FK)
+				for (uint32_t i = 0; i < n; ++i)
+					m[i] = x[i].i64 == k;
+			else if (*op == JY_OP_LT_FK)
+				for (uint32_t i = 0; i < n; ++i)
+					m[i] = x[i].i64 < k;
+			else
+				for (uint32_t i = 0; i < n; ++i)
+					m[i] = x[i].i64 > k;
+
+			pc += 5;
+			break;
+		}
+		case JY_OP_ADD:
+		case JY_OP_SUB:
+		case JY_OP_MUL: {
+			const union jy_value *x = b->slot[top - 2];
+			const union jy_value *y = b->slot[top - 1];
+			union jy_value	     *z = b->vstack;
+
+			z += (top - 2) * BATCHSZ;
+
+			// unsigned, the rows that already failed may overflow
+			if (*op == JY_OP_ADD)
+				for (uint32_t i = 0; i < n; ++i)
+					z[i].u64 = x[i].u64 + y[i].u64;
+			else if (*op == JY_OP_SUB)
+				for (uint32_t i = 0; i < n; ++i)
+					z[i].u64 = x[i].u64 - y[i].u64;
+			else
+				for (uint32_t i = 0; i < n; ++i)
+					z[i].u64 = x[i].u64 * y[i].u64;
+
+			b->slot[top - 2]  = z;
+			top		 -= 1;
+			pc		 += 1;
+			break;
+		}
+		case JY_OP_CMP:
+		case JY_OP_LT:
+		case JY_OP_GT: {
+			const union jy_value *x = b->slot[top - 2];
+			const union jy_value *y = b->slot[top - 1];
+
+			if (*op == JY_OP_CMP)
+				for (uint32_t i = 0; i < n; ++i)
+					m[i] = x[i].i64 == y[i].i64;
+			else if (*op == JY_OP_LT)
+				for (uint32_t i = 0; i < n; ++i)
+					m[i] = x[i].i64 < y[i].i64;
+			else
+				for (uint32_t i = 0; i < n; ++i)
+					m[i] = x[i].i64 > y[i].i64;
+
+			top -= 2;
+			pc  += 1;
+			break;
+		}
+		case JY_OP_NOT:
+			for (uint32_t i = 0; i < n; ++i)
+				m[i] = !m[i];
+
+			pc += 1;
+			break;
+		case JY_OP_JMPF: {
+			uint32_t selsz = 0;
+
+			for (uint32_t i = 0; i < b->selsz; ++i) {
+				b->sel[selsz]  = b->sel[i];
+				selsz	      += m[b->sel[i]];
+			}
+
+			b->selsz  = selsz;
+			pc	 += 3;
+			break;
+		}
+		default:
+			return false;
+		}
 	}
 
-	case JY_K_BOOL:
-	case JY_K_ULONG:
-	case JY_K_LONG: {
-		errno = 0;
+	*ops += run * n;
 
-		if (str != NULL)
-			value->i64 = strtol(str, NULL, 10);
-		else
-			value->i64 = 0;
+	return true;
+}
 
-		if (errno == EINVAL)
-			goto INV_VALUE;
-		break;
+// Filters the buffered rows, then runs the rest of the chunk row by row
+// for the survivors.
+static int batch_run(struct match_data *data,
+		     int		colsz,
+		     const struct Qcol *cols)
+{
+	int		      ret   = 0;
+	struct batch	     *b	    = data->batch;
+	const union jy_value *vals  = data->vals;
+	const uint8_t	     *codes = data->codes;
+	char		     *strs  = data->row->buf;
+	struct runtime	      ctx   = {
+			 .names	 = data->names,
+			 .vals	 = vals,
+			 .otypes = data->otypes,
+			 .stack	 = data->stack,
+			 .regs	 = data->regs,
+	};
+
+	if (batch_filter(b, codes, vals, colsz, cols, &data->state->ops)) {
+		codes += b->prefix;
+	} else {
+		b->selsz = b->size;
+
+		for (uint32_t i = 0; i < b->size; ++i)
+			b->sel[i] = i;
 	}
-	default:
-		goto INV_VALUE;
+
+	for (uint32_t i = 0; i < b->selsz; ++i) {
+		uint32_t r = b->sel[i];
+
+		if (data->state->latency)
+			data->state->ingest = b->ingest[r];
+
+		for (int c = 0; c < colsz; ++c) {
+			const struct Qcol *col = &cols[c];
+			union jy_value	   v   = b->cells[c * BATCHSZ + r];
+
+			if (col->type == JY_K_STR && v.ofs & 1)
+				v.str = (struct jy_str *) (strs + v.ofs - 1);
+
+			col->event->vals[col->member] = v;
+		}
+
+		if (interpret(&ctx, codes, data->state))
+			goto PANIC;
+	}
+
+	goto FINISH;
+
+PANIC:
+	ret = 1;
+
+FINISH:
+	b->size		= 0;
+	data->row->size = 0;
+	free_runtime(&ctx);
+	return ret;
+}
+
+// Buffers the row, the batch runs once full or after the last row.
+static int batch_clbk(struct match_data	  *data,
+		      struct sqlite3_stmt *stmt,
+		      int		   colsz,
+		      const struct Qcol	  *cols)
+{
+	struct batch	 *b    = data->batch;
+	struct sb_mem	 *row  = data->row;
+	struct jy_intern *istr = data->state->strs;
+
+	if (stmt == NULL)
+		return b->size ? batch_run(data, colsz, cols) : 0;
+
+	if (b->cells == NULL)
+		b->cells = jry_alloc(sizeof(*b->cells) * BATCHSZ
+				     * (colsz ? colsz : 1));
+
+	if (b->cells == NULL)
+		return 1;
+
+	for (int i = 0; i < colsz; ++i) {
+		union jy_value *v = &b->cells[i * BATCHSZ + b->size];
+
+		switch (cols[i].type) {
+		case JY_K_STR: {
+			const void    *text = sqlite3_column_text(stmt, i);
+			uint32_t       len  = sqlite3_column_bytes(stmt, i);
+			uint32_t       ofs  = row->size;
+			struct jy_str *str  = jry_intern(istr, text ? text : "",
+							 len);
+
+			if (str != NULL) {
+				v->str = str;
+				break;
+			}
+
+			str = sb_append(row, 0, rowstrsz(len));
+
+			if (str == NULL)
+				return 1;
+
+			str->size = len;
+			memcpy(str->cstr, text ? text : "", len);
+			str->cstr[len] = '\0';
+
+			v->ofs = ofs | 1;
+			break;
+		}
+		case JY_K_BOOL:
+		case JY_K_ULONG:
+		case JY_K_LONG:
+			v->i64 = sqlite3_column_int64(stmt, i);
+			break;
+		default:
+			return 1;
+		}
 	}
 
+	if (data->state->latency)
+		b->ingest[b->size] = sqlite3_column_int64(stmt, colsz);
+
+	if (++b->size == BATCHSZ)
+		return batch_run(data, colsz, cols);
+
 	return 0;
+}
+
+// strings that outlive the row go to the output arena when there is one
+static inline void *strmem(struct sc_mem   *sbuf,
+			   struct jy_state *state,
+			   uint32_t	    size)
+{
+	if (state != NULL && state->arena != NULL)
+		return sa_alloc(state->arena, size);
+
+	return sc_alloc(sbuf, size);
+}
+
+// Appends v to the rule output. Row strings only live until the next row
+// so they are copied, interned ones outlive the execution.
+static inline int output(struct sc_mem	 *sbuf,
+			 struct jy_state *state,
+			 union jy_value	  v,
+			 enum jy_ktype	  t)
+{
+	if (t == JY_K_STR && !jry_interned(state->strs, v.str)) {
+		uint32_t       len = v.str->size;
+		struct jy_str *str = strmem(sbuf, state, rowstrsz(len));
+
+		if (str == NULL)
+			return 1;
+
+		memcpy(str, v.str, sizeof(*str) + len + 1);
+		v.str = str;
+	}
+
+	state->out = sb_add(state->outm, 0, sizeof(v));
+
+	if (state->out == NULL)
+		return 1;
+
+	state->out[state->outsz]  = v;
+	state->outsz		 += 1;
+
+	return 0;
+}
+
+// Hands the n values of a matched row to the stream, then appends them
+// to the rule output unless only the stream wants them.
+static inline int outrow(struct sc_mem	      *sbuf,
+			 struct jy_state      *state,
+			 const union jy_value *values,
+			 uint32_t	       n,
+			 const enum jy_ktype  *types)
+{
+	if (state->stream != NULL) {
+		if (state->stream(state->streamdata, values, n))
+			return 1;
+
+		if (state->streamonly)
+			return 0;
+	}
+
+	for (uint32_t i = 0; i < n; ++i)
+		if (output(sbuf, state, values[i],
+			   types ? types[i] : JY_K_UNKNOWN))
+			return 1;
+
+	if (state->ingm == NULL)
+		return 0;
+
+	uint32_t rows = state->ingm->size / sizeof(uint64_t);
+
+	state->ingests = sb_add(state->ingm, 0, sizeof(uint64_t));
+
+	if (state->ingests == NULL)
+		return 1;
+
+	state->ingests[rows] = state->ingest;
+
+	return 0;
+}
+
+// joins the n strings at args, the size is known before the only copy
+static inline struct jy_str *concat(struct sc_mem	 *sbuf,
+				    struct jy_state	 *state,
+				    const union jy_value *args,
+				    uint32_t		  n)
+{
+	uint32_t strsz = 0;
+
+	for (uint32_t i = 0; i < n; ++i)
+		strsz += args[i].str->size;
+
+	struct jy_str *result = strmem(sbuf, state, rowstrsz(strsz));
+
+	if (result == NULL)
+		return NULL;
+
+	char *mem = result->cstr;
+
+	for (uint32_t i = 0; i < n; ++i) {
+		memcpy(mem, args[i].str->cstr, args[i].str->size);
+		mem += args[i].str->size;
+	}
+
+	result->size	    = strsz;
+	result->cstr[strsz] = '\0';
+
+	return result;
+}
+
+static int native_output(const struct jy_native *rt,
+			 const union jy_value	*values,
+			 uint32_t		 n)
+{
+	struct jy_state *state = rt->state;
+
+	return outrow(state->lifetime, state, values, n, rt->otypes);
+}
+
+static struct jy_str *native_concat(struct jy_state	 *state,
+				    const union jy_value *args,
+				    uint32_t		  n)
+{
+	return concat(state->lifetime, state, args, n);
+}
+
+// SQLite calls it every PROGRESSOPS of its own instructions, nonzero
+// interrupts the statement
+static int progress(void *data)
+{
+	struct jy_state *state = data;
+
+	if (jry_monotonic() < state->deadline)
+		return 0;
+
+	state->limited = true;
 
-OUT_OF_MEMORY:
 	return 1;
+}
 
-INV_VALUE:
-	return 2;
+// count the row against the rule budget, true once it is exceeded
+static inline bool overrun(struct jy_state *state)
+{
+	state->rows += 1;
+
+	if (state->maxrows && state->rows > state->maxrows)
+		state->limited = true;
+
+	if (state->maxops && state->ops > state->maxops)
+		state->limited = true;
+
+	return state->limited;
 }
 
-static inline int match_clbk(struct match_data *data,
-			     int		colsz,
-			     char	      **values,
-			     char	      **columns)
+static inline int match_clbk(struct match_data	*data,
+			     struct sqlite3_stmt *stmt,
+			     int		  colsz,
+			     const struct Qcol	 *cols)
 {
-	int		      ret   = SQLITE_OK;
+	if (stmt != NULL && overrun(data->state))
+		return 1;
+
+	if (data->batch != NULL)
+		return batch_clbk(data, stmt, colsz, cols);
+
+	if (stmt == NULL)
+		return 0;
+
+	int		      ret   = 0;
 	struct jy_defs	     *names = data->names;
 	const uint8_t	     *codes = data->codes;
 	struct jy_state	     *state = data->state;
 	const union jy_value *vals  = data->vals;
+	struct sb_mem	     *row   = data->row;
 	struct runtime	      ctx   = {
-			 .names = names,
-			 .vals	= vals,
-			 .pc	= &codes,
+			 .names	 = names,
+			 .vals	 = vals,
+			 .otypes = data->otypes,
+			 .stack	 = data->stack,
+			 .regs	 = data->regs,
 	};
 
+	if (state->latency)
+		state->ingest = sqlite3_column_int64(stmt, colsz);
+
+	uint32_t rowsz = 0;
+
 	for (int i = 0; i < colsz; ++i) {
-		union jy_value	view  = { .handle = NULL };
-		struct jy_defs *event = NULL;
-		size_t		len   = strlen(columns[i]) + 1;
+		const struct Qcol *col = &cols[i];
+		union jy_value	  *v   = &col->event->vals[col->member];
 
-		char  buf[len];
-		char *sep;
-		char *key;
-		char *member;
+		if (col->type != JY_K_STR)
+			continue;
 
-		mempcpy(buf, columns[i], len);
-		sep = strchr(buf, '.');
+		// text conversion must happen before asking for the size
+		const char *text = (void *) sqlite3_column_text(stmt, i);
+		uint32_t    len	 = sqlite3_column_bytes(stmt, i);
 
-		assert(sep != NULL);
+		v->str = jry_intern(state->strs, text ? text : "", len);
 
-		*sep   = '\0';
-		key    = buf;
-		member = sep + 1;
+		if (v->str == NULL)
+			rowsz += rowstrsz(len);
+	}
 
-		if (def_get(names, key, &view, NULL))
-			goto PANIC;
+	row->size = 0;
 
-		event = view.def;
+	if (rowsz && sb_reserve(row, 0, rowsz) == NULL)
+		goto PANIC;
 
-		if (event == NULL)
-			goto PANIC;
+	char *mem = row->buf;
 
-		enum jy_ktype type;
+	for (int i = 0; i < colsz; ++i) {
+		const struct Qcol *col = &cols[i];
+		union jy_value	  *v   = &col->event->vals[col->member];
 
-		if (def_get(event, member, &view, &type))
-			goto PANIC;
+		switch (col->type) {
+		case JY_K_STR: {
+			const void    *text = sqlite3_column_text(stmt, i);
+			uint32_t       len  = sqlite3_column_bytes(stmt, i);
+			struct jy_str *str  = (struct jy_str *) mem;
 
-		// TODO: Handle error message
-		if (value_from_cstr(state->lifetime, &view, type, values[i]))
-			goto PANIC;
+			if (v->str != NULL)
+				break;
+
+			str->size = len;
+			memcpy(str->cstr, text ? text : "", len);
+			str->cstr[len] = '\0';
 
-		if (def_set(event, member, view, type))
+			mem    += rowstrsz(len);
+			v->str	= str;
+			break;
+		}
+		case JY_K_BOOL:
+		case JY_K_ULONG:
+		case JY_K_LONG:
+			v->i64 = sqlite3_column_int64(stmt, i);
+			break;
+		default:
 			goto PANIC;
+		}
 	}
 
-	for (; **ctx.pc != JY_OP_END;)
-		switch (interpret(&ctx, state)) {
-		case 0:
-			continue;
-		default:
+	if (data->native != NULL) {
+		if (data->native(vals, data->rt))
 			goto PANIC;
-		};
+	} else if (interpret(&ctx, codes, state)) {
+		goto PANIC;
+	}
 
 	goto FINISH;
 
 PANIC:
-	ret = SQLITE_ABORT;
+	ret = 1;
 
 FINISH:
 	free_runtime(&ctx);
 	return ret;
 }
 
-static inline int interpret(struct runtime *ctx,
-			    struct jy_state *restrict state)
+// Runs verified codes until END, operands are not checked here. The pc,
+// stack pointer and flag stay local so the compiler can keep them in
+// registers across opcodes.
+static int interpret(struct runtime *ctx,
+		     const uint8_t  *codes,
+		     struct jy_state *restrict state)
 {
 	assert(ctx->vals != NULL);
-	assert(ctx->pc != NULL);
-	assert(*ctx->pc != NULL);
 	assert(ctx->names != NULL);
+	assert(codes != NULL);
 
 	int		      ret    = 0;
 	struct sqlite3	     *db     = ctx->db;
 	const union jy_value *vals   = ctx->vals;
-	const uint8_t	    **code   = ctx->pc;
 	const uint8_t	     *fcodes = ctx->fcodes;
 	struct jy_defs	     *names  = ctx->names;
+	struct sc_mem	     *rbuf   = &ctx->buf;
+	struct sc_mem	     *sbuf   = state ? state->lifetime : rbuf;
+	struct jy_intern     *strs   = state ? state->strs : NULL;
+
+	const uint8_t  *pc   = codes;
+	bool		flag = false;
+	union jy_value *sp   = ctx->stack;
+	uint32_t	top  = 0;
+	// instructions run, added to the rule budget when done
+	uint64_t	ops  = 0;
+
+// the compiler sized the stack, see verify_chunk()
+#define PUSH(__v) (sp[top++] = (__v))
+
+#define POP()	  (sp[--top])
+#define ARG(__t)  (*(const __t *) (pc + 1))
+// field and constant of the fused compares
+#define FIELD()	  (vals[vals[ARG(uint16_t)].dscptr.name].def \
+			   ->vals[vals[ARG(uint16_t)].dscptr.member])
+#define CNST()	  (vals[*(const uint16_t *) (pc + 3)])
+
+#ifdef THREADED
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+	static const void *labels[JY_OP_END + 1] = {
+		[JY_OP_PUSH8]     = &&OP_PUSH8,
+		[JY_OP_PUSH16]    = &&OP_PUSH16,
+		[JY_OP_DUP]       = &&OP_DUP,
+		[JY_OP_SETR]      = &&OP_SETR,
+		[JY_OP_GETR]      = &&OP_GETR,
+		[JY_OP_SETBF8]    = &&OP_SETBF8,
+		[JY_OP_LOAD]      = &&OP_LOAD,
+		[JY_OP_JOIN]      = &&OP_JOIN,
+		[JY_OP_EQUAL]     = &&OP_EQUAL,
+		[JY_OP_JMPT]      = &&OP_JMPT,
+		[JY_OP_JMPF]      = &&OP_JMPF,
+		[JY_OP_CALL]      = &&OP_CALL,
+		[JY_OP_CALLV]     = &&OP_CALLV,
+		[JY_OP_QUERY]     = &&OP_QUERY,
+		[JY_OP_REGEX]     = &&OP_REGEX,
+		[JY_OP_BETWEEN]   = &&OP_BETWEEN,
+		[JY_OP_OUTPUT]    = &&OP_OUTPUT,
+		[JY_OP_WITHIN]    = &&OP_WITHIN,
+		[JY_OP_NOT]       = &&OP_NOT,
+		[JY_OP_CMPSTR]    = &&OP_CMPSTR,
+		[JY_OP_CMP]       = &&OP_CMP,
+		[JY_OP_LT]        = &&OP_LT,
+		[JY_OP_GT]        = &&OP_GT,
+		[JY_OP_ADD]       = &&OP_ADD,
+		[JY_OP_CONCATN]   = &&OP_CONCATN,
+		[JY_OP_SUB]       = &&OP_SUB,
+		[JY_OP_MUL]       = &&OP_MUL,
+		[JY_OP_DIV]       = &&OP_DIV,
+		[JY_OP_END]       = &&OP_END,
+		[JY_OP_CMPSTR_FK] = &&OP_CMPSTR_FK,
+		[JY_OP_CMP_FK]    = &&OP_CMP_FK,
+		[JY_OP_LT_FK]     = &&OP_LT_FK,
+		[JY_OP_GT_FK]     = &&OP_GT_FK,
+	};
 
-	struct stack  *stack  = &ctx->stack;
-	union flag8   *flag   = &ctx->flag;
-	struct sc_mem *rbuf   = &ctx->buf;
-	struct sc_mem *sbuf   = state ? state->lifetime : rbuf;
-	const uint8_t *pc     = *code;
-	enum jy_opcode opcode = *pc;
-
-	union {
-		const uint8_t  *bytes;
-		const int16_t  *i16;
-		const uint8_t  *u8;
-		const uint16_t *u16;
-		const uint32_t *u32;
-	} arg = { .bytes = pc + 1 };
-
-	switch (opcode) {
-	case JY_OP_END:
-		// shouldnt come here
-		assert(opcode != JY_OP_END);
-		break;
-	case JY_OP_SETBF8:
-		flag->bits.b8  = pop(stack).i64;
-		pc	      += 1;
-		break;
-
-	case JY_OP_PUSH8: {
-		union jy_value v = vals[*arg.u8];
-
-		if (push(stack, v))
-			goto OUT_OF_MEMORY;
+#define CASE(__op) OP_##__op
+#define NEXT()	   do { ops += 1; goto *labels[*pc]; } while (0)
+#else
+#define CASE(__op) case JY_OP_##__op
+#define NEXT()	   do { ops += 1; goto DISPATCH; } while (0)
+#endif
+
+#ifdef THREADED
+	NEXT();
+#else
+DISPATCH:
+	switch (*pc) {
+	default:
+		goto INVARIANT;
+#endif
 
-		pc += 2;
-		break;
-	}
-	case JY_OP_PUSH16: {
-		union jy_value v = vals[*arg.u16];
+CASE(END):
+	goto FINISH;
 
-		if (push(stack, v))
-			goto OUT_OF_MEMORY;
+CASE(SETBF8):
+	flag  = POP().i64;
+	pc   += 1;
+	NEXT();
 
-		pc += 3;
-		break;
-	}
-	case JY_OP_CALL: {
-		uint8_t paramsz = arg.u8[0];
+CASE(PUSH8):
+	PUSH(vals[ARG(uint8_t)]);
+	pc += 2;
+	NEXT();
 
-		union jy_value args[paramsz];
+CASE(PUSH16):
+	PUSH(vals[ARG(uint16_t)]);
+	pc += 3;
+	NEXT();
 
-		for (size_t i = 0; i < paramsz; ++i)
-			args[i] = pop(stack);
+CASE(DUP):
+	PUSH(sp[ARG(uint8_t)]);
+	pc += 2;
+	NEXT();
 
-		struct jy_func *func = pop(stack).func;
+CASE(SETR):
+	ctx->regs[ARG(uint8_t)]	 = POP();
+	pc			+= 2;
+	NEXT();
 
-		union jy_value retval;
+CASE(GETR):
+	PUSH(ctx->regs[ARG(uint8_t)]);
+	pc += 2;
+	NEXT();
 
-		func->func(state, paramsz, args, &retval);
+CASE(CALL): {
+	uint8_t paramsz = ARG(uint8_t);
 
-		switch (func->return_type) {
-		case JY_K_LONG:
-		case JY_K_STR:
-		case JY_K_BOOL:
-			push(stack, retval);
-			break;
-		default:
-			break;
-		}
+	union jy_value args[paramsz];
 
-		pc += 2;
+	for (size_t i = 0; i < paramsz; ++i)
+		args[i] = POP();
 
-		break;
-	}
-	case JY_OP_JMPF:
-		if (!flag->bits.b8)
-			pc += *arg.i16;
-		else
-			pc += 3;
-		break;
-	case JY_OP_JMPT:
-		if (flag->bits.b8)
-			pc += *arg.i16;
-		else
-			pc += 3;
-		break;
-	case JY_OP_NOT:
-		flag->bits.b8  = !flag->bits.b8;
-		pc	      += 1;
-		break;
-	case JY_OP_LOAD: {
-		struct jy_desc	d     = pop(stack).dscptr;
-		struct jy_defs *event = vals[d.name].def;
-		union jy_value	v     = event->vals[d.member];
-
-		if (push(stack, v))
-			goto OUT_OF_MEMORY;
+	struct jy_func *func = POP().func;
 
-		pc += 1;
-		break;
-	}
-	case JY_OP_OUTPUT: {
-		uint64_t       length = pop(stack).u64;
-		union jy_value values[length];
+	union jy_value retval;
 
-		for (uint64_t i = 0; i < length; ++i)
-			values[i] = pop(stack);
+	func->func(state, paramsz, args, &retval);
 
-		for (uint64_t i = length; i > 0; --i) {
-			union jy_value v = values[i - 1];
-			state->out	 = sb_add(state->outm, 0, sizeof(v));
+	PUSH(retval);
 
-			if (state->out == NULL)
-				goto OUT_OF_MEMORY;
+	pc += 2;
+	NEXT();
+}
 
-			state->out[state->outsz]  = v;
-			state->outsz		 += 1;
-		}
+CASE(CALLV): {
+	uint8_t paramsz = ARG(uint8_t);
 
-		pc += 1;
-		break;
-	}
-	case JY_OP_BETWEEN: {
-		long		max   = pop(stack).i64;
-		long		min   = pop(stack).i64;
-		struct jy_desc	d     = pop(stack).dscptr;
-		struct jy_defs *event = vals[d.name].def;
+	union jy_value args[paramsz];
 
-		struct QMbetween *Q = sc_alloc(rbuf, sizeof *Q);
-		uint32_t	  namefield;
+	for (size_t i = 0; i < paramsz; ++i)
+		args[i] = POP();
 
-		if (!def_find(event, "__name__", &namefield))
-			goto INVARIANT;
+	struct jy_func *func = POP().func;
 
-		Q->type	  = QM_BETWEEN;
-		Q->max	  = max;
-		Q->min	  = min;
-		Q->table  = event->vals[namefield].str->cstr;
-		Q->column = event->keys[d.member];
+	union jy_value retval;
 
-		union jy_value view = { .handle = Q };
+	func->func(state, paramsz, args, &retval);
 
-		if (push(stack, view))
-			goto OUT_OF_MEMORY;
+	pc += 2;
+	NEXT();
+}
 
-		pc += 1;
-		break;
-	}
-	case JY_OP_WITHIN: {
-		struct jy_time_ofs timeofs = pop(stack).timeofs;
-		struct jy_desc	   d	   = pop(stack).dscptr;
-		struct jy_defs	  *names   = vals[d.name].def;
+CASE(JMPF):
+	pc += !flag ? ARG(int16_t) : 3;
+	NEXT();
 
-		struct QMwithin *Q = sc_alloc(rbuf, sizeof *Q);
+CASE(JMPT):
+	pc += flag ? ARG(int16_t) : 3;
+	NEXT();
 
-		if (Q == NULL)
-			goto OUT_OF_MEMORY;
+CASE(NOT):
+	flag  = !flag;
+	pc   += 1;
+	NEXT();
 
-		Q->type	   = QM_WITHIN;
-		Q->table   = names->keys[d.member];
-		Q->column  = "__arrival__";
-		Q->timeofs = timeofs;
+CASE(LOAD): {
+	struct jy_desc	d     = POP().dscptr;
+	struct jy_defs *event = vals[d.name].def;
 
-		union jy_value view = { .handle = Q };
+	PUSH(event->vals[d.member]);
 
-		if (push(stack, view))
-			goto OUT_OF_MEMORY;
+	pc += 1;
+	NEXT();
+}
 
-		pc += 1;
-		break;
-	}
-	case JY_OP_JOIN: {
-		struct jy_desc	d2     = pop(stack).dscptr;
-		struct jy_desc	d1     = pop(stack).dscptr;
-		struct jy_defs *event2 = vals[d2.name].def;
-		struct jy_defs *event1 = vals[d1.name].def;
+CASE(OUTPUT): {
+	uint64_t length = POP().u64;
 
-		uint32_t field2;
-		uint32_t field1;
+	// the values are still in place below the length, the stream sees
+	// them without a copy
+	top -= length;
 
-		if (!def_find(event1, "__name__", &field1))
-			goto INVARIANT;
+	if (outrow(sbuf, state, sp + top, length, ctx->otypes))
+		goto OUT_OF_MEMORY;
 
-		if (!def_find(event2, "__name__", &field2))
-			goto INVARIANT;
+	pc += 1;
+	NEXT();
+}
 
-		struct QMjoin *Q = sc_alloc(rbuf, sizeof *Q);
+CASE(BETWEEN): {
+	long		max   = POP().i64;
+	long		min   = POP().i64;
+	struct jy_desc	d     = POP().dscptr;
+	struct jy_defs *event = vals[d.name].def;
 
-		if (Q == NULL)
-			goto OUT_OF_MEMORY;
+	struct QMbetween *Q = sc_alloc(rbuf, sizeof *Q);
+	uint32_t	  namefield;
 
-		Q->type	     = QM_JOIN;
-		Q->tbl_left  = event2->vals[field2].str->cstr;
-		Q->col_left  = event2->keys[d2.member];
-		Q->tbl_right = event1->vals[field1].str->cstr;
-		Q->col_right = event1->keys[d1.member];
+	if (Q == NULL)
+		goto OUT_OF_MEMORY;
 
-		union jy_value view = { .handle = Q };
+	def_find(event, "__name__", &namefield);
 
-		if (push(stack, view))
-			goto OUT_OF_MEMORY;
+	Q->type	  = QM_BETWEEN;
+	Q->max	  = max;
+	Q->min	  = min;
+	Q->table  = event->vals[namefield].str->cstr;
+	Q->column = event->keys[d.member];
 
-		pc += 1;
-		break;
-	}
-	case JY_OP_REGEX: {
-		struct jy_str  *regexstr = pop(stack).str;
-		struct jy_desc	d	 = pop(stack).dscptr;
-		struct jy_defs *event	 = vals[d.name].def;
-		uint32_t	field;
+	PUSH((union jy_value) { .handle = Q });
 
-		struct QMbinary *Q = sc_alloc(rbuf, sizeof *Q);
+	pc += 1;
+	NEXT();
+}
 
-		if (!def_find(event, "__name__", &field))
-			goto INVARIANT;
+CASE(WITHIN): {
+	struct jy_time_ofs timeofs = POP().timeofs;
+	struct jy_desc	   d	   = POP().dscptr;
+	struct jy_defs	  *names   = vals[d.name].def;
 
-		if (Q == NULL)
-			goto OUT_OF_MEMORY;
+	struct QMwithin *Q = sc_alloc(rbuf, sizeof *Q);
 
-		Q->type		  = QM_BINARY;
-		Q->table	  = event->vals[field].str->cstr;
-		Q->column	  = event->keys[d.member];
-		Q->value.type	  = QME_REGEXP;
-		Q->value.as.regex = regexstr->cstr;
+	if (Q == NULL)
+		goto OUT_OF_MEMORY;
 
-		union jy_value view = { .handle = Q };
+	Q->type	   = QM_WITHIN;
+	Q->table   = names->keys[d.member];
+	Q->column  = "__arrival__";
+	Q->timeofs = timeofs;
 
-		if (push(stack, view))
-			goto OUT_OF_MEMORY;
+	PUSH((union jy_value) { .handle = Q });
 
-		pc += 1;
+	pc += 1;
+	NEXT();
+}
 
-		break;
-	}
-	case JY_OP_EQUAL: {
-		union jy_value	right  = pop(stack);
-		struct jy_desc	dscptr = pop(stack).dscptr;
-		struct jy_defs *event  = vals[dscptr.name].def;
+CASE(JOIN): {
+	struct jy_desc	d2     = POP().dscptr;
+	struct jy_desc	d1     = POP().dscptr;
+	struct jy_defs *event2 = vals[d2.name].def;
+	struct jy_defs *event1 = vals[d1.name].def;
 
-		uint32_t field;
+	uint32_t field2;
+	uint32_t field1;
 
-		if (!def_find(event, "__name__", &field))
-			goto INVARIANT;
+	def_find(event1, "__name__", &field1);
 
-		struct QMbinary *Q = sc_alloc(rbuf, sizeof *Q);
+	def_find(event2, "__name__", &field2);
 
-		if (Q == NULL)
-			goto OUT_OF_MEMORY;
+	struct QMjoin *Q = sc_alloc(rbuf, sizeof *Q);
 
-		Q->type	  = QM_BINARY;
-		Q->table  = event->vals[field].str->cstr;
-		Q->column = event->keys[dscptr.member];
+	if (Q == NULL)
+		goto OUT_OF_MEMORY;
 
-		switch (event->types[dscptr.member]) {
-		case JY_K_STR:
-			Q->value.type	 = QME_CSTR;
-			Q->value.as.cstr = right.str->cstr;
-			break;
-		case JY_K_LONG:
-			Q->value.type	= QME_LONG;
-			Q->value.as.i64 = right.i64;
-			break;
-		default:
-			goto QUERY_FAILED;
-		}
+	Q->type	     = QM_JOIN;
+	Q->tbl_left  = event2->vals[field2].str->cstr;
+	Q->col_left  = event2->keys[d2.member];
+	Q->tbl_right = event1->vals[field1].str->cstr;
+	Q->col_right = event1->keys[d1.member];
 
-		union jy_value sql = { .handle = Q };
+	PUSH((union jy_value) { .handle = Q });
 
-		if (push(stack, sql))
-			goto OUT_OF_MEMORY;
+	pc += 1;
+	NEXT();
+}
+
+CASE(REGEX): {
+	struct jy_str  *regexstr = POP().str;
+	struct jy_desc	d	 = POP().dscptr;
+	struct jy_defs *event	 = vals[d.name].def;
+	uint32_t	field;
+
+	struct QMbinary *Q = sc_alloc(rbuf, sizeof *Q);
+
+	def_find(event, "__name__", &field);
+
+	if (Q == NULL)
+		goto OUT_OF_MEMORY;
+
+	Q->type		  = QM_BINARY;
+	Q->table	  = event->vals[field].str->cstr;
+	Q->column	  = event->keys[d.member];
+	Q->value.type	  = QME_REGEXP;
+	Q->value.as.regex = regexstr->cstr;
+
+	PUSH((union jy_value) { .handle = Q });
+
+	pc += 1;
+	NEXT();
+}
 
-		pc += 1;
-		break;
+CASE(EQUAL): {
+	union jy_value	right  = POP();
+	struct jy_desc	dscptr = POP().dscptr;
+	struct jy_defs *event  = vals[dscptr.name].def;
+
+	uint32_t field;
+
+	def_find(event, "__name__", &field);
+
+	struct QMbinary *Q = sc_alloc(rbuf, sizeof *Q);
+
+	if (Q == NULL)
+		goto OUT_OF_MEMORY;
+
+	Q->type	  = QM_BINARY;
+	Q->table  = event->vals[field].str->cstr;
+	Q->column = event->keys[dscptr.member];
+
+	// verified to be either a string or a long field
+	if (event->types[dscptr.member] == JY_K_STR) {
+		Q->value.type	 = QME_CSTR;
+		Q->value.as.cstr = right.str->cstr;
+	} else {
+		Q->value.type	= QME_LONG;
+		Q->value.as.i64 = right.i64;
 	}
-	case JY_OP_QUERY: {
-		unsigned long  ofs   = pop(stack).ofs;
-		const uint8_t *chunk = fcodes + ofs;
-		long	       qlen  = pop(stack).i64;
-		struct QMbase *qs[qlen];
-
-		for (int i = 0; i < qlen; ++i)
-			qs[i] = pop(stack).handle;
-
-		struct Qmatch Q = {
-			.qlen  = qlen,
-			.qlist = qs,
-			.names = names,
-		};
 
-		q_clbk *callback = (q_clbk *) match_clbk;
+	PUSH((union jy_value) { .handle = Q });
+
+	pc += 1;
+	NEXT();
+}
+
+CASE(QUERY): {
+	const struct jy_jay *jay   = ctx->jay;
+	unsigned long	     rule  = POP().ofs;
+	const uint8_t	    *chunk = fcodes + jay->rulefofs[rule];
+	long		     qlen  = POP().i64;
+	struct QMbase	    *qs[qlen];
 
-		struct match_data data = {
+	for (int i = 0; i < qlen; ++i)
+		qs[i] = POP().handle;
+
+	struct Qmatch Q = {
+		.qlen	= qlen,
+		.qlist	= qs,
+		.names	= names,
+		.vals	= vals,
+		.reads	= jay->reads + jay->rulerofs[rule],
+		.readsz = jay->rulersz[rule],
+		.where	= jay->rulewhere[rule],
+		.window = state->window,
+		.tiered = state->tiered,
+		.ingest = state->latency,
+	};
+
+	q_clbk *callback = (q_clbk *) match_clbk;
+
+	struct batch   *batch  = NULL;
+	jy_native_rule *native = NULL;
+
+	if (state->native != NULL)
+		native = state->native[rule];
+
+	// every row agrees on the prologue, it runs before the first one
+	union jy_value *regs  = NULL;
+	uint16_t	regsz = jay->rulereg[rule];
+
+	if (ctx->plan == NULL && regsz) {
+		regs = sc_alloc(rbuf, sizeof(*regs) * regsz);
+
+		if (regs == NULL)
+			goto OUT_OF_MEMORY;
+
+		struct runtime pctx = {
 			.names = names,
-			.codes = chunk,
 			.vals  = vals,
-			.state = state,
+			.stack = sp + top,
+			.regs  = regs,
 		};
 
-		switch (q_match(db, NULL, callback, &data, Q)) {
-		case 1:
-			goto OUT_OF_MEMORY;
-		case 2:
-			goto QUERY_FAILED;
-		}
+		int pres = interpret(&pctx,
+				     jay->pcodes + jay->rulepofs[rule], state);
 
-		pc += 1;
-		break;
-	}
-	case JY_OP_CMPSTR: {
-		struct jy_str *v2 = pop(stack).str;
-		struct jy_str *v1 = pop(stack).str;
-		const char    *s2 = v2->cstr;
-		const char    *s1 = v1->cstr;
-		size_t	       z2 = v2->size;
-		size_t	       z1 = v1->size;
-
-		flag->bits.b8  = z1 == z2 && memcmp(s1, s2, z1) == 0;
-		pc	      += 1;
-		break;
-	}
-	case JY_OP_CMP: {
-		long v2	      = pop(stack).i64;
-		long v1	      = pop(stack).i64;
-		flag->bits.b8 = v1 == v2;
+		free_runtime(&pctx);
 
-		pc += 1;
-		break;
+		if (pres)
+			goto OUT_OF_MEMORY;
 	}
-	case JY_OP_LT: {
-		long v2 = pop(stack).i64;
-		long v1 = pop(stack).i64;
 
-		flag->bits.b8 = v1 < v2;
+	struct jy_native rt = {
+		.output = native_output,
+		.concat = native_concat,
+		.state	= state,
+		.regs	= regs,
+		.otypes = jay->outtypes + jay->ruleoofs[rule],
+	};
+
+	// native code is already cheaper per row than a batch, and a
+	// streamed row goes out as soon as it matches
+	if (ctx->plan == NULL && native == NULL && state->stream == NULL
+	    && jay->rulebatch[rule]) {
+		batch = batch_new(jay->rulebatch[rule],
+				  jay->rulestack[rule] + 1);
 
-		pc += 1;
-		break;
+		if (batch == NULL)
+			goto OUT_OF_MEMORY;
 	}
-	case JY_OP_GT: {
-		long v2 = pop(stack).i64;
-		long v1 = pop(stack).i64;
 
-		flag->bits.b8 = v1 > v2;
+	struct sb_mem	  row  = { .buf = NULL };
+	struct match_data data = {
+		.names	= names,
+		.codes	= chunk,
+		.vals	= vals,
+		.otypes = jay->outtypes + jay->ruleoofs[rule],
+		.row	= &row,
+		.stack	= sp + top,
+		.batch	= batch,
+		.native = native,
+		.rt	= &rt,
+		.regs	= regs,
+		.state	= state,
+	};
 
-		pc += 1;
-		break;
-	}
-	case JY_OP_ADD: {
-		union jy_value v2  = pop(stack);
-		union jy_value v1  = pop(stack);
-		v1.i64		  += v2.i64;
+	int res;
 
-		push(stack, v1);
+	if (ctx->plan == NULL && state->deadline)
+		sqlite3_progress_handler(db, PROGRESSOPS, progress, state);
 
-		pc += 1;
-		break;
-	}
-	case JY_OP_SUB: {
-		union jy_value v2  = pop(stack);
-		union jy_value v1  = pop(stack);
-		v1.i64		  -= v2.i64;
+	if (ctx->plan != NULL)
+		res = q_plan(db, Q, ctx->plan);
+	else
+		res = q_match(db, NULL, callback, &data, Q,
+			      state->profile ? state->prof : NULL);
 
-		push(stack, v1);
+	if (state->deadline)
+		sqlite3_progress_handler(db, 0, NULL, NULL);
 
-		pc += 1;
-		break;
+	sb_free(&row);
+	batch_free(batch);
+
+	switch (res) {
+	case 1:
+		goto OUT_OF_MEMORY;
+	case 2:
+		goto QUERY_FAILED;
 	}
-	case JY_OP_MUL: {
-		union jy_value v2  = pop(stack);
-		union jy_value v1  = pop(stack);
-		v1.i64		  *= v2.i64;
 
-		push(stack, v1);
+	pc += 1;
+	NEXT();
+}
 
-		pc += 1;
-		break;
-	}
-	case JY_OP_DIV: {
-		union jy_value v2  = pop(stack);
-		union jy_value v1  = pop(stack);
-		v1.i64		  /= v2.i64;
+CASE(CMPSTR): {
+	struct jy_str *v2 = POP().str;
+	struct jy_str *v1 = POP().str;
 
-		push(stack, v1);
+	flag  = streq(strs, v1, v2);
+	pc   += 1;
+	NEXT();
+}
 
-		pc += 1;
-		break;
-	}
-	case JY_OP_CONCAT: {
-		union jy_value result;
+CASE(CMP): {
+	long v2 = POP().i64;
+	long v1 = POP().i64;
 
-		struct jy_str *v2 = pop(stack).str;
-		struct jy_str *v1 = pop(stack).str;
+	flag  = v1 == v2;
+	pc   += 1;
+	NEXT();
+}
 
-		size_t strsz = v2->size + v1->size;
-		char   buf[strsz + 1];
+CASE(LT): {
+	long v2 = POP().i64;
+	long v1 = POP().i64;
 
-		strcpy(buf, v1->cstr);
-		strcat(buf, v2->cstr);
+	flag  = v1 < v2;
+	pc   += 1;
+	NEXT();
+}
 
-		uint32_t allocsz = sizeof(struct jy_str) + strsz + 1;
-		result.str	 = sc_alloc(sbuf, allocsz);
+CASE(GT): {
+	long v2 = POP().i64;
+	long v1 = POP().i64;
 
-		if (result.str == NULL)
-			goto OUT_OF_MEMORY;
+	flag  = v1 > v2;
+	pc   += 1;
+	NEXT();
+}
 
-		result.str->size = strsz;
-		memcpy(result.str->cstr, buf, strsz);
+CASE(CMPSTR_FK): {
+	struct jy_str *v1 = FIELD().str;
+	struct jy_str *v2 = CNST().str;
 
-		push(stack, result);
+	flag  = streq(strs, v1, v2);
+	pc   += 5;
+	NEXT();
+}
 
-		pc += 1;
-		break;
-	}
-	default:
-		goto INVARIANT;
+CASE(CMP_FK):
+	flag  = FIELD().i64 == CNST().i64;
+	pc   += 5;
+	NEXT();
+
+CASE(LT_FK):
+	flag  = FIELD().i64 < CNST().i64;
+	pc   += 5;
+	NEXT();
+
+CASE(GT_FK):
+	flag  = FIELD().i64 > CNST().i64;
+	pc   += 5;
+	NEXT();
+
+CASE(ADD):
+	top		-= 1;
+	sp[top - 1].i64 += sp[top].i64;
+	pc		+= 1;
+	NEXT();
+
+CASE(SUB):
+	top		-= 1;
+	sp[top - 1].i64 -= sp[top].i64;
+	pc		+= 1;
+	NEXT();
+
+CASE(MUL):
+	top		-= 1;
+	sp[top - 1].i64 *= sp[top].i64;
+	pc		+= 1;
+	NEXT();
+
+CASE(DIV):
+	top		-= 1;
+	sp[top - 1].i64 /= sp[top].i64;
+	pc		+= 1;
+	NEXT();
+
+CASE(CONCATN): {
+	uint8_t	       n      = ARG(uint8_t);
+	struct jy_str *result = concat(sbuf, state, sp + top - n, n);
+
+	if (result == NULL)
+		goto OUT_OF_MEMORY;
+
+	top -= n;
+	PUSH((union jy_value) { .str = result });
+
+	pc += 2;
+	NEXT();
+}
+
+#ifdef THREADED
+#pragma GCC diagnostic pop
+#else
 	}
+#endif
 
-	goto FINISH;
+#undef CASE
+#undef NEXT
+#undef ARG
+#undef FIELD
+#undef CNST
+#undef POP
+#undef PUSH
 
 OUT_OF_MEMORY:
 	ret = 1;
 	goto FINISH;
+
 QUERY_FAILED:
 	ret = 2;
 	goto FINISH;
 
+#ifndef THREADED
 INVARIANT:
 	ret = 3;
+#endif
 
 FINISH:
-	// PC is not moving...
-	assert(pc != *code);
+	if (state != NULL)
+		state->ops += ops;
 
-	*code = pc;
 	return ret;
 }
 
-int jry_exec(struct sqlite3	 *db,
-	     const struct jy_jay *jay,
-	     const uint8_t	 *codes,
-	     struct jy_state	 *state)
+static int run(struct sqlite3	    *db,
+	       const struct jy_jay *jay,
+	       const uint8_t	   *codes,
+	       struct jy_state	   *state,
+	       char		  **plan)
 {
-	int		      ret  = 0;
-	const union jy_value *vals = jay->vals;
-	const uint8_t	     *pc   = codes;
+	int ret = 0;
 
 	struct runtime ctx = {
 		.db	= db,
 		.names	= jay->names,
-		.vals	= vals,
-		.pc	= &pc,
+		.vals	= jay->vals,
 		.fcodes = jay->fcodes,
+		.jay	= jay,
+		.plan	= plan,
+		.stack	= state->stack,
 	};
 
-	for (; *pc != JY_OP_END;) {
-		switch (interpret(&ctx, state)) {
-		case 0:
-			continue;
-		case 1:
-			goto OUT_OF_MEMORY;
-		case 2:
-			goto QUERY_FAILED;
-		}
+	if (ctx.stack == NULL)
+		ctx.stack = jry_alloc(sizeof(*ctx.stack) * (jay->stackmax + 1));
+
+	if (ctx.stack == NULL)
+		goto OUT_OF_MEMORY;
+
+	switch (interpret(&ctx, codes, state)) {
+	case 1:
+		goto OUT_OF_MEMORY;
+	case 2:
+		goto QUERY_FAILED;
+	case 3:
+		goto INVARIANT;
 	}
 
 	goto FINISH;
@@ -727,10 +1515,37 @@ OUT_OF_MEMORY:
 	ret = 1;
 	goto FINISH;
 
+INVARIANT:
+	ret = 4;
+	goto FINISH;
+
 QUERY_FAILED:
-	ret = 2;
+	// a budget stopped the query, it did not fail
+	ret = state->limited ? 3 : 2;
 
 FINISH:
+	if (ctx.stack != state->stack)
+		jry_free(ctx.stack);
+
 	free_runtime(&ctx);
 	return ret;
 }
+
+int jry_exec(struct sqlite3	 *db,
+	     const struct jy_jay *jay,
+	     const uint8_t	 *codes,
+	     struct jy_state	 *state)
+{
+	return run(db, jay, codes, state, NULL);
+}
+
+int jry_plan(struct sqlite3	 *db,
+	     const struct jy_jay *jay,
+	     const uint8_t	 *codes,
+	     struct jy_state	 *state,
+	     char		**text)
+{
+	*text = NULL;
+
+	return run(db, jay, codes, state, text);
+}
@@ -32,21 +32,115 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef JAYVM_EXEC_H
 #define JAYVM_EXEC_H
 
+#include "jary/native.h"
+
+#include <stdbool.h>
 #include <stdint.h>
+#include <time.h>
 
 struct sqlite3;
 struct jy_jay;
 
+// row strings longer than this are rarely repeated, they are not interned
+#define JRY_INTERNLEN 64
+
+// Strings of the constant pool and of result rows with the same bytes
+// share one copy, equal strings then compare by pointer. The arena never
+// moves, interned strings live until jry_intern_reset().
+struct jy_intern {
+	char	 *arena;
+	// hash and arena offset plus one of every entry, 0 is empty
+	uint64_t *slots;
+	uint32_t  arenasz;
+	uint32_t  entsz;
+	// arena bytes jry_intern_reset() keeps
+	uint32_t  keepsz;
+	// set once a string did not fit
+	bool	  full;
+};
+
+// returns the interned copy of str, NULL when there is no room for it
+struct jy_str *jry_intern(struct jy_intern *t, const char *str, uint32_t len);
+// interns the string constants of jay and keeps them across resets
+void	       jry_intern_pool(struct jy_intern *t, struct jy_jay *jay);
+// drops every row string, and the constants too when all is set
+void	       jry_intern_reset(struct jy_intern *t, bool all);
+void	       jry_intern_free(struct jy_intern *t);
+
+static inline bool jry_interned(const struct jy_intern *t,
+				const struct jy_str    *str)
+{
+	return t != NULL
+	    && (uintptr_t) str - (uintptr_t) t->arena < t->arenasz;
+}
+
 struct jy_state {
 	union jy_value *out;
 	struct sc_mem  *lifetime;
 	struct sb_mem  *outm;
-	uint16_t	outsz;
+	// VM stack of at least jay->stackmax values, when NULL jry_exec
+	// allocates one per call
+	union jy_value *stack;
+	// native free chunk of every rule, NULL to interpret the bytecode
+	jy_native_rule *const *native;
+	// row strings are interned here when set
+	struct jy_intern      *strs;
+	// rendered output strings, lifetime holds them when NULL
+	struct sa_mem	      *arena;
+	// gets the values of every matched row as soon as it is produced,
+	// they are only valid during the call. Nonzero stops the query.
+	int (*stream)(void *, const union jy_value *, uint32_t);
+	void	       *streamdata;
+	// rows are not appended to out when only the stream wants them
+	bool		streamonly;
+	// hot tier window in seconds, see jary_storage()
+	long		window;
+	bool		tiered;
+	// rule budget, zero is unlimited. The deadline is CLOCK_MONOTONIC
+	// nanoseconds, jry_exec returns 3 once one is exceeded.
+	uint64_t	maxops;
+	uint64_t	maxrows;
+	uint64_t	deadline;
+	// spent so far, instructions include the ones of every row
+	uint64_t	ops;
+	uint64_t	rows;
+	bool		limited;
+	// nanoseconds spent preparing and then stepping the rule query,
+	// only counted when profile is set
+	uint64_t	prof[2];
+	bool		profile;
+	// the query also returns the newest __ingest__ of the row events,
+	// ingest holds it for the current row. When ingm is set it gets
+	// one per row appended to out, as ingests.
+	bool		latency;
+	uint64_t	ingest;
+	struct sb_mem  *ingm;
+	uint64_t       *ingests;
+	uint32_t	outsz;
 };
 
+static inline uint64_t jry_monotonic(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+// 0 on success, 1 out of memory, 2 the query failed, 3 the rule budget
+// ran out and 4 the bytecode is invalid
 int jry_exec(struct sqlite3	 *db,
 	     const struct jy_jay *jay,
 	     const uint8_t	 *codes,
 	     struct jy_state	 *state);
 
+// explain the rule query in codes instead of running it, text is
+// allocated with malloc.
+int jry_plan(struct sqlite3	 *db,
+	     const struct jy_jay *jay,
+	     const uint8_t	 *codes,
+	     struct jy_state	 *state,
+	     char		**text);
+
 #endif // JAYVM_EXEC_H
@@ -0,0 +1,79 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2024. Muhammad Raznan. All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "histogram.h"
+
+uint64_t jry_hist_merge(uint64_t *counts, const struct jy_hist *hist)
+{
+	uint64_t total = 0;
+
+	for (uint32_t i = 0; i < JRY_HISTSIZE; ++i) {
+		uint64_t count = atomic_load_explicit(&hist->counts[i],
+						      memory_order_relaxed);
+
+		counts[i] += count;
+		total	  += count;
+	}
+
+	return total;
+}
+
+uint64_t jry_hist_quantile(const uint64_t *counts,
+			   uint64_t	   total,
+			   uint32_t	   ppm)
+{
+	uint64_t rank = (total * ppm + 999999) / 1000000;
+	uint64_t seen = 0;
+	uint32_t i    = 0;
+
+	if (total == 0)
+		return 0;
+
+	if (rank == 0)
+		rank = 1;
+
+	for (; i < JRY_HISTSIZE - 1; ++i) {
+		seen += counts[i];
+
+		if (seen >= rank)
+			break;
+	}
+
+	if (i < 1 << JRY_HISTSUB)
+		return i;
+
+	uint32_t exp = (i >> JRY_HISTSUB) + JRY_HISTSUB - 1;
+	uint32_t sub = i & JRY_HISTMASK;
+	uint64_t low = (uint64_t) ((1 << JRY_HISTSUB) + sub)
+		    << (exp - JRY_HISTSUB);
+
+	return low + ((uint64_t) 1 << (exp - JRY_HISTSUB)) - 1;
+}
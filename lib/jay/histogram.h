@@ -0,0 +1,87 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2024. Muhammad Raznan. All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef JAYVM_HISTOGRAM_H
+#define JAYVM_HISTOGRAM_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+// Log bucketed like an HDR histogram: values below 2^JRY_HISTSUB are
+// exact, past that every power of two is split in 2^JRY_HISTSUB
+// buckets, so a value is off by at most 1/16. Values of 2^JRY_HISTMAX
+// and more land in the last bucket.
+#define JRY_HISTSUB  4
+#define JRY_HISTMAX  40
+#define JRY_HISTSIZE ((JRY_HISTMAX - JRY_HISTSUB + 1) << JRY_HISTSUB)
+#define JRY_HISTMASK ((1 << JRY_HISTSUB) - 1)
+
+// a single thread records, any other one may read the counts at the
+// same time and see them slightly behind
+struct jy_hist {
+	_Atomic uint64_t counts[JRY_HISTSIZE];
+};
+
+static inline uint32_t jry_hist_bucket(uint64_t value)
+{
+	if (value >= (uint64_t) 1 << JRY_HISTMAX)
+		value = ((uint64_t) 1 << JRY_HISTMAX) - 1;
+
+	if (value < 1 << JRY_HISTSUB)
+		return value;
+
+	uint32_t exp = 63 - __builtin_clzll(value);
+	uint32_t sub = (value >> (exp - JRY_HISTSUB)) & JRY_HISTMASK;
+
+	return ((exp - JRY_HISTSUB + 1) << JRY_HISTSUB) + sub;
+}
+
+static inline void jry_hist_record(struct jy_hist *hist, uint64_t value)
+{
+	_Atomic uint64_t *count = &hist->counts[jry_hist_bucket(value)];
+
+	// only one writer, no need for a locked add
+	atomic_store_explicit(count,
+			      atomic_load_explicit(count, memory_order_relaxed)
+				      + 1,
+			      memory_order_relaxed);
+}
+
+// adds the counts of hist to counts, returns how many values it holds
+uint64_t jry_hist_merge(uint64_t *counts, const struct jy_hist *hist);
+
+// highest value of the bucket holding the quantile of counts, given in
+// parts per million
+uint64_t jry_hist_quantile(const uint64_t *counts,
+			   uint64_t	   total,
+			   uint32_t	   ppm);
+
+#endif // JAYVM_HISTOGRAM_H
@@ -39,9 +39,15 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "ast.h"
 #include "compiler.h"
+#include "dload.h"
+#include "emit.h"
 #include "error.h"
 #include "exec.h"
+#include "histogram.h"
 #include "parser.h"
+#include "ring.h"
+#include "sink.h"
+#include "suppress.h"
 #include "token.h"
 
 #include "jary/defs.h"
@@ -49,8 +55,12 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <assert.h>
 #include <sqlite3.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 struct exec {
 	const struct jy_tkns  *tkns;
@@ -65,6 +75,56 @@ struct jyOutput {
 	union jy_value *values;
 };
 
+struct jyBatch {
+	// rows held and rows before delivery
+	unsigned int size;
+	unsigned int capacity;
+	unsigned int width;
+	// column major outputs, a string column also has the lengths
+	struct jyColumn {
+		enum jy_ktype type;
+		void	     *values;
+		unsigned int *lens;
+	} *cols;
+	// string columns point here until the batch is delivered
+	struct sa_mem strs;
+};
+
+struct rule_batch {
+	int (*callback)(void *, const struct jyBatch *);
+	void	      *data;
+	struct jyBatch batch;
+	// the callback returned JARY_INT_FINAL
+	bool	       final;
+};
+
+// rule output written to a sink, see jary_rule_sink()
+struct rule_sink {
+	// rule name or NULL, time is only written when set
+	const char  *rule;
+	bool	     time;
+	uint16_t     sink;
+};
+
+// listeners of a rule, indexes into the callback, batch and sink arrays
+struct rule_disp {
+	uint16_t *clbks;
+	uint16_t *batches;
+	uint16_t *sinks;
+	uint16_t  clbksz;
+	uint16_t  batchsz;
+	uint16_t  sinksz;
+	// rows are handed to the match ring
+	bool	  ring;
+};
+
+// budget of a rule per execution, zero is unlimited
+struct rule_limit {
+	uint64_t ops;
+	uint64_t rows;
+	uint64_t nsec;
+};
+
 struct jary {
 	struct sc_mem	sc;
 	struct sb_mem	sb;
@@ -77,10 +137,54 @@ struct jary {
 	const char   ***ev_cols;
 	const char   ***ev_vals;
 	int (**r_clbks)(void *, const struct jyOutput *);
-	uint16_t *r_clbk_ords;
 	void	**r_clbk_datas;
+	// called per matched row instead of once per rule
+	bool	 *r_clbk_rows;
+	// columnar callbacks, see jary_rule_batch_clbk()
+	struct rule_batch *r_batches;
+	uint16_t	   r_batch_sz;
+	// listeners by rule ordinal, filled when a callback is registered
+	struct rule_disp  *r_disp;
+	// buffers by file descriptor, shared by the rules writing to it
+	struct jy_sink	  *r_sinks;
+	struct rule_sink  *r_rsinks;
+	uint16_t	   r_sink_sz;
+	uint16_t	   r_rsink_sz;
+	// matches polled by another thread, see jary_ring()
+	struct jy_ring	  *ring;
+	// outputs seen by rules with a suppress section, NULL for others
+	struct jy_suppress **r_supps;
+	// see jary_rule_limit(), NULL when no rule has one
+	struct rule_limit  *r_limits;
+	// set by jary_interrupt(), possibly from another thread
+	atomic_bool	    interrupt;
+	// counters handed out by jary_stats(), and the ingress of every
+	// name ordinal within ev_stats
+	struct jyStats		stats;
+	struct jyRuleStats     *r_stats;
+	struct jyIngressStats  *ev_stats;
+	uint16_t	       *ev_ingress;
+	bool			profile;
+	// ingest to callback latency of every rule, see jary_latency()
+	struct jy_hist	       *r_hists;
+	bool			latency;
+	// enqueue time of the oldest event no execution finished with, the
+	// rows stamped before it were recorded already
+	uint64_t		ev_ingest;
 	uint32_t  ev_sz;
 	uint16_t  r_clbk_sz;
+	// rows older than this many seconds migrate to the disk
+	long	  window;
+	bool	  tiered;
+	// VM stack shared by every rule
+	union jy_value *stack;
+	// rules built by jary_native(), NULL runs bytecode
+	void			*native_so;
+	jy_native_rule *const	*native;
+	// constants and repeated row strings, see jry_intern()
+	struct jy_intern	 strs;
+	// output strings of the last execution, reused by the next one
+	struct sa_mem		 arena;
 };
 
 static inline int prtknln(int		  bufsz,
@@ -179,6 +283,7 @@ NEXT_TKN:
 
 static inline int prcrtevt(int bufsz,
 			   char *restrict buf,
+			   const char		*schema,
 			   const char		*name,
 			   const struct jy_defs *event)
 {
@@ -186,7 +291,9 @@ static inline int prcrtevt(int bufsz,
 #define PTR()  sz ? buf + sz : buf
 	int sz = 0;
 
-	sz += snprintf(PTR(), SIZE(), "CREATE TABLE IF NOT EXISTS %s (", name);
+	const char fmt[] = "CREATE TABLE IF NOT EXISTS %s.%s (";
+
+	sz += snprintf(PTR(), SIZE(), fmt, schema, name);
 
 	for (size_t i = 0; i < event->capacity; ++i) {
 		const char *type   = NULL;
@@ -217,9 +324,11 @@ static inline int prcrtevt(int bufsz,
 	if (buf) {
 		buf[sz - 1] = ')';
 		buf[sz]	    = ';';
+		buf[sz + 1] = '\0';
 	}
 
-	sz += 1;
+	// include ';' and '\0'
+	sz += 2;
 
 	return sz;
 
@@ -229,6 +338,7 @@ static inline int prcrtevt(int bufsz,
 
 static inline int prinsevt(int bufsz,
 			   char *restrict buf,
+			   const char  *schema,
 			   const char  *name,
 			   uint32_t	length,
 			   const char **keys,
@@ -238,7 +348,7 @@ static inline int prinsevt(int bufsz,
 #define PTR()  sz ? buf + sz : buf
 	int sz = 0;
 
-	sz += snprintf(PTR(), SIZE(), "INSERT INTO %s (", name);
+	sz += snprintf(PTR(), SIZE(), "INSERT INTO %s.%s (", schema, name);
 
 	for (uint32_t i = 0; i < length; ++i) {
 		const char *column = keys[i];
@@ -266,8 +376,33 @@ static inline int prinsevt(int bufsz,
 	if (buf) {
 		buf[sz - 1] = ')';
 		buf[sz]	    = ';';
+		buf[sz + 1] = '\0';
 	}
 
+	// include ';' and '\0'
+	sz += 2;
+
+	return sz;
+#undef SIZE
+#undef PTR
+}
+
+static inline int prmigevt(int bufsz,
+			   char *restrict buf,
+			   const char *name,
+			   long	       cutoff)
+{
+#define SIZE() bufsz ? bufsz - sz : 0
+#define PTR()  sz ? buf + sz : buf
+	int sz = 0;
+
+	const char fmt[] = "INSERT INTO main.%s SELECT * FROM hot.%s"
+			   " WHERE __arrival__ <= %ld;"
+			   "DELETE FROM hot.%s WHERE __arrival__ <= %ld;";
+
+	sz += snprintf(PTR(), SIZE(), fmt, name, name, cutoff, name, cutoff);
+
+	// include '\0'
 	sz += 1;
 
 	return sz;
@@ -275,20 +410,20 @@ static inline int prinsevt(int bufsz,
 #undef PTR
 }
 
-static inline int rule_clbks(size_t		    rule,
-			     const struct jyOutput *output,
-			     size_t		    length,
-			     const uint16_t	   *ords,
-			     void *const	   *datas,
+static inline int rule_clbks(const struct rule_disp *disp,
+			     const struct jyOutput  *output,
+			     void *const	    *datas,
+			     const bool		    *rows,
 			     int (*const *clbks)(void *data,
 						 const struct jyOutput *))
 {
-	for (size_t i = 0; i < length; ++i) {
-		if (ords[i] != rule)
+	for (size_t i = 0; i < disp->clbksz; ++i) {
+		uint16_t c = disp->clbks[i];
+
+		if (rows[c])
 			continue;
 
-		void *data = datas[i];
-		switch (clbks[i](data, output)) {
+		switch (clbks[c](datas[c], output)) {
 		case JARY_INT_CRASH:
 			return JARY_INT_CRASH;
 		case JARY_INT_FINAL:
@@ -300,6 +435,272 @@ FINISH:
 	return JARY_OK;
 }
 
+struct row_clbks {
+	const struct rule_disp *disp;
+	void *const	       *datas;
+	const bool	       *rows;
+	int (*const *clbks)(void *data, const struct jyOutput *);
+	// callbacks that returned JARY_INT_FINAL
+	bool		       *final;
+	struct rule_batch      *batches;
+	struct jy_sink	       *sinks;
+	const struct rule_sink *rsinks;
+	struct jy_ring	       *ring;
+	uint16_t		rule;
+	// output types of the rule, and the time written by sinks
+	const enum jy_ktype    *types;
+	long			time;
+	// rows handed out, and the time spent doing it while profiling
+	uint64_t		matches;
+	uint64_t		clbkns;
+	// newest enqueue time of the current row events, NULL hist when
+	// latency is not recorded, rows stamped before since are old
+	const uint64_t	       *ingest;
+	struct jy_hist	       *hist;
+	uint64_t		since;
+	bool			crash;
+	bool			oom;
+	bool			sinkerr;
+};
+
+// time since ingest goes to hist when the row was not matched by an
+// earlier execution, nor stamped by a clock before a reboot
+static inline void record_ingest(struct jy_hist *hist,
+				 uint64_t	 since,
+				 uint64_t	 ingest)
+{
+	uint64_t now = jry_monotonic();
+
+	if (ingest >= since && ingest <= now)
+		jry_hist_record(hist, now - ingest);
+}
+
+// hands the rows held by b to its callback and empties it
+static int batch_flush(struct rule_batch *b)
+{
+	int ret = JARY_OK;
+
+	if (b->batch.size && !b->final)
+		ret = b->callback(b->data, &b->batch);
+
+	if (ret == JARY_INT_FINAL)
+		b->final = true;
+
+	b->batch.size = 0;
+	sa_reset(&b->batch.strs);
+
+	return ret;
+}
+
+// copies one row into the columns of b, strings included since the row
+// is gone after the stream call
+static int batch_add(struct jyBatch *b, const union jy_value *values)
+{
+	unsigned int r = b->size;
+
+	for (unsigned int i = 0; i < b->width; ++i) {
+		struct jyColumn *col = &b->cols[i];
+		union jy_value	 v   = values[i];
+
+		switch (col->type) {
+		case JY_K_STR: {
+			char *str = sa_alloc(&b->strs, v.str->size + 1);
+
+			if (str == NULL)
+				return 1;
+
+			memcpy(str, v.str->cstr, v.str->size + 1);
+
+			((const char **) col->values)[r] = str;
+			col->lens[r]			 = v.str->size;
+			break;
+		}
+		case JY_K_BOOL:
+			((unsigned char *) col->values)[r] = v.i64 != 0;
+			break;
+		default:
+			((long *) col->values)[r] = v.i64;
+			break;
+		}
+	}
+
+	b->size += 1;
+
+	return 0;
+}
+
+// stream of a rule with row or batch callbacks, the output is a view of
+// the VM stack that is gone after the call
+static int row_clbks(void *data, const union jy_value *values, uint32_t size)
+{
+	struct row_clbks *r	 = data;
+	struct jyOutput	  output = {
+		  .size	  = size,
+		  .values = (union jy_value *) values,
+	};
+
+	r->matches += 1;
+
+	if (r->hist != NULL)
+		record_ingest(r->hist, r->since, *r->ingest);
+
+	for (size_t i = 0; i < r->disp->clbksz; ++i) {
+		uint16_t c = r->disp->clbks[i];
+
+		if (!r->rows[c] || r->final[c])
+			continue;
+
+		switch (r->clbks[c](r->datas[c], &output)) {
+		case JARY_INT_CRASH:
+			r->crash = true;
+			return 1;
+		case JARY_INT_FINAL:
+			r->final[c] = true;
+			break;
+		};
+	}
+
+	for (size_t i = 0; i < r->disp->batchsz; ++i) {
+		struct rule_batch *b = &r->batches[r->disp->batches[i]];
+
+		if (b->final)
+			continue;
+
+		if (batch_add(&b->batch, values)) {
+			r->oom = true;
+			return 1;
+		}
+
+		if (b->batch.size < b->batch.capacity)
+			continue;
+
+		if (batch_flush(b) == JARY_INT_CRASH) {
+			r->crash = true;
+			return 1;
+		}
+	}
+
+	// a full ring drops the row, the producer never waits
+	if (r->disp->ring)
+		jry_ring_push(r->ring, r->rule, values, r->types, size);
+
+	for (size_t i = 0; i < r->disp->sinksz; ++i) {
+		const struct rule_sink *rs = &r->rsinks[r->disp->sinks[i]];
+
+		long ts = rs->time ? r->time : -1;
+
+		if (jry_sink_ndjson(&r->sinks[rs->sink], rs->rule, ts, values,
+				    r->types, size)) {
+			r->sinkerr = true;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+// latency of the rows handed out at once to the rule callbacks
+static void record_rows(struct jy_hist	      *hist,
+			const struct jy_state *state,
+			uint16_t	       width,
+			uint64_t	       since)
+{
+	for (uint32_t r = 0; width && r < state->outsz; r += width)
+		record_ingest(hist, since, state->ingests[r / width]);
+}
+
+// row_clbks() when profiling
+static int timed_row_clbks(void		     *data,
+			   const union jy_value *values,
+			   uint32_t		 size)
+{
+	struct row_clbks *r	= data;
+	uint64_t	  start = jry_monotonic();
+	int		  ret	= row_clbks(data, values, size);
+
+	r->clbkns += jry_monotonic() - start;
+
+	return ret;
+}
+
+// drop the output rows seen within the suppression window, the rows left
+// go to the row listeners since the rule was not streamed
+static int suppress_rows(struct jy_suppress *supp,
+			 struct row_clbks   *rowc,
+			 struct jy_state    *state,
+			 uint16_t	     width,
+			 bool		     byrow)
+{
+	const enum jy_ktype *types = rowc->types;
+	union jy_value	    *out   = state->out;
+	uint32_t	     kept  = 0;
+
+	// nothing tells rows apart
+	if (width == 0)
+		return 0;
+
+	for (uint32_t r = 0; r + width <= state->outsz; r += width) {
+		if (jry_suppressed(supp, rowc->time, out + r, types, width))
+			continue;
+
+		memmove(out + kept, out + r, sizeof(*out) * width);
+
+		// the ingest times follow their rows
+		if (state->ingests != NULL) {
+			uint64_t ingest = state->ingests[r / width];
+
+			state->ingests[kept / width] = ingest;
+			state->ingest		     = ingest;
+		}
+
+		if (byrow && row_clbks(rowc, out + kept, width))
+			return 1;
+
+		kept += width;
+	}
+
+	state->outsz = kept;
+
+	return 0;
+}
+
+// move rows that left the hot window into the disk tier
+static inline int migrate(struct jary *J, struct sc_mem *sc)
+{
+	struct jy_defs *names  = J->code->jay->names;
+	long		cutoff = time(NULL) - J->window;
+
+	if (sqlite3_exec(J->db, "BEGIN;", NULL, NULL, NULL) != SQLITE_OK)
+		return 1;
+
+	for (uint32_t i = 0; i < names->capacity; ++i) {
+		const char *table = names->keys[i];
+
+		if (table == NULL || names->types[i] != JY_K_EVENT)
+			continue;
+
+		int   sz  = prmigevt(0, NULL, table, cutoff);
+		char *sql = sc_alloc(sc, sz);
+
+		if (sql == NULL)
+			goto ROLLBACK;
+
+		prmigevt(sz, sql, table, cutoff);
+
+		if (sqlite3_exec(J->db, sql, NULL, NULL, NULL) != SQLITE_OK)
+			goto ROLLBACK;
+	}
+
+	if (sqlite3_exec(J->db, "COMMIT;", NULL, NULL, NULL) != SQLITE_OK)
+		goto ROLLBACK;
+
+	return 0;
+
+ROLLBACK:
+	sqlite3_exec(J->db, "ROLLBACK;", NULL, NULL, NULL);
+	return 1;
+}
+
 int jary_open(struct jary **jary)
 {
 	int	     ret;
@@ -341,7 +742,7 @@ int jary_open(struct jary **jary)
 	if (sc_reap(&J->sc, &J->r_clbk_datas, (free_t) ifree))
 		goto OUT_OF_MEMORY;
 
-	if (sc_reap(&J->sc, &J->r_clbk_ords, (free_t) ifree))
+	if (sc_reap(&J->sc, &J->r_clbk_rows, (free_t) ifree))
 		goto OUT_OF_MEMORY;
 
 	if (sc_reap(&J->sc, &J->r_clbks, (free_t) ifree))
@@ -382,6 +783,48 @@ int jary_modulepath(struct jary *jary, const char *path)
 	return JARY_OK;
 }
 
+int jary_storage(struct jary *J, const char *path, unsigned long window)
+{
+	struct sqlite3 *db = NULL;
+
+	if (J->code->jay != NULL) {
+		J->errmsg = "storage must be set before compiling";
+		return JARY_ERROR;
+	}
+
+	int flag = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
+
+	if (sqlite3_open_v2(path, &db, flag, NULL))
+		goto OPEN_FAIL;
+
+	// WAL keeps readers off the writer, and the mmap saves a copy
+	// per page read.
+	const char sql[] = "PRAGMA main.journal_mode=WAL;"
+			   "PRAGMA main.synchronous=NORMAL;"
+			   "PRAGMA main.mmap_size=268435456;"
+			   "ATTACH DATABASE ':memory:' AS hot;";
+
+	if (sqlite3_exec(db, sql, NULL, NULL, NULL) != SQLITE_OK)
+		goto OPEN_FAIL;
+
+	sqlite3_close_v2(J->db);
+
+	J->db	  = db;
+	J->window = window;
+	J->tiered = true;
+	J->errmsg = "not an error";
+
+	return JARY_OK;
+
+OPEN_FAIL:
+	J->errmsg = "unable to open storage";
+
+	// sqlite3 allocates a handle even when it fails to open
+	sqlite3_close_v2(db);
+
+	return JARY_ERR_SQLITE3;
+}
+
 int jary_event(struct jary *J, const char *name, unsigned int *event)
 {
 	int ret = JARY_OK;
@@ -396,12 +839,16 @@ int jary_event(struct jary *J, const char *name, unsigned int *event)
 
 	struct jy_defs *names = J->code->jay->names;
 	struct sc_mem  *sc    = &J->sc;
+	uint32_t	id;
 
-	if (!def_find(names, name, NULL)) {
+	if (!def_find(names, name, &id)) {
 		J->errmsg = "event not expected";
 		return JARY_ERR_NOTEXIST;
 	}
 
+	if (names->types[id] == JY_K_EVENT)
+		J->ev_stats[J->ev_ingress[id]].events += 1;
+
 	char *table = NULL;
 
 	sc_strfmt(sc, &table, "%s", name);
@@ -440,6 +887,15 @@ FINISH:
 	*event	  = J->ev_sz;
 	J->ev_sz += 1;
 
+	if (ret == JARY_OK && J->latency) {
+		uint64_t now = jry_monotonic();
+
+		if (J->ev_ingest == 0)
+			J->ev_ingest = now;
+
+		ret = jary_field_long(J, *event, "__ingest__", now);
+	}
+
 	return ret;
 }
 
@@ -894,6 +1350,22 @@ int jary_compile(struct jary *jary,
 	if (code->errs->size)
 		goto COMPILE_FAIL;
 
+	jry_intern_pool(&jary->strs, jay);
+
+	for (size_t i = 0; i < jay->rulesz; ++i) {
+		if (jay->rulesuppress[i] == 0)
+			continue;
+
+		if (jary->r_supps == NULL)
+			jary->r_supps = calloc(jay->rulesz, sizeof(void *));
+
+		if (jary->r_supps == NULL)
+			goto OUT_OF_MEMORY;
+
+		if (jry_suppress_new(&jary->r_supps[i], jay->rulesuppress[i]))
+			goto OUT_OF_MEMORY;
+	}
+
 	struct jy_defs *names	= code->jay->names;
 	size_t		eventsz = 0;
 	const char    **table	= sc_alloc(&bump, sizeof(void *) * names->size);
@@ -906,36 +1378,99 @@ int jary_compile(struct jary *jary,
 	if (events == NULL)
 		goto OUT_OF_MEMORY;
 
+	free(jary->r_stats);
+	free(jary->ev_stats);
+	free(jary->ev_ingress);
+	free(jary->r_hists);
+
+	// sized by the rules, jary_latency() has to be called again
+	jary->r_hists = NULL;
+	jary->latency = false;
+
+	jary->r_stats	 = calloc(jay->rulesz + 1, sizeof(*jary->r_stats));
+	jary->ev_stats	 = calloc(names->size + 1, sizeof(*jary->ev_stats));
+	jary->ev_ingress = calloc(names->capacity, sizeof(uint16_t));
+
+	if (!jary->r_stats || !jary->ev_stats || !jary->ev_ingress)
+		goto OUT_OF_MEMORY;
+
+	for (size_t i = 0; i < jay->rulesz; ++i)
+		jary->r_stats[i].name = names->keys[jay->rulenids[i]];
+
 	for (size_t i = 0; i < names->capacity; ++i) {
 		switch (names->types[i]) {
 		case JY_K_EVENT:
-			table[eventsz]	 = names->keys[i];
-			events[eventsz]	 = names->vals[i].def;
-			eventsz		+= 1;
+			jary->ev_stats[eventsz].name  = names->keys[i];
+			jary->ev_ingress[i]	      = eventsz;
+			table[eventsz]		      = names->keys[i];
+			events[eventsz]		      = names->vals[i].def;
+			eventsz			     += 1;
 			break;
 		default:
 			continue;
 		}
 	}
 
+	jary->stats.ingress  = jary->ev_stats;
+	jary->stats.rules    = jary->r_stats;
+	jary->stats.ingressz = eventsz;
+	jary->stats.rulesz   = jay->rulesz;
+
+	// same layout in both tiers, so rows can move with SELECT *
+	const char *schemas[] = { "main", "hot" };
+	size_t	    schemasz  = jary->tiered ? 2 : 1;
+
 	for (size_t i = 0; i < eventsz; ++i) {
-		int sz = prcrtevt(0, NULL, table[i], events[i]);
+		for (size_t j = 0; j < schemasz; ++j) {
+			const char *schema = schemas[j];
 
-		char *sql = sc_alloc(&bump, sz);
+			int sz = prcrtevt(0, NULL, schema, table[i], events[i]);
 
-		if (sql == NULL)
-			goto OUT_OF_MEMORY;
+			char *sql = sc_alloc(&bump, sz);
 
-		prcrtevt(sz, sql, table[i], events[i]);
+			if (sql == NULL)
+				goto OUT_OF_MEMORY;
 
-		switch (sqlite3_exec(jary->db, sql, NULL, NULL, NULL)) {
-		case SQLITE_OK:
-			break;
-		default:
-			goto CREATE_TABLE_FAIL;
+			prcrtevt(sz, sql, schema, table[i], events[i]);
+
+			switch (sqlite3_exec(jary->db, sql, NULL, NULL, NULL)) {
+			case SQLITE_OK:
+				break;
+			default:
+				goto CREATE_TABLE_FAIL;
+			}
 		}
+
+		if (!jary->tiered)
+			continue;
+
+		char	  *idx	 = NULL;
+		const char fmt[] = "CREATE INDEX IF NOT EXISTS"
+				   " main.%s__arrival__ ON %s (__arrival__);";
+
+		sc_strfmt(&bump, &idx, fmt, table[i], table[i]);
+
+		if (idx == NULL)
+			goto OUT_OF_MEMORY;
+
+		if (sqlite3_exec(jary->db, idx, NULL, NULL, NULL) != SQLITE_OK)
+			goto CREATE_TABLE_FAIL;
 	}
 
+	// cache line aligned, aligned_alloc wants a multiple of it
+	size_t stacksz = sizeof(union jy_value) * (jay->stackmax + 1);
+	stacksz	       = (stacksz + 63) & ~(size_t) 63;
+
+	free(jary->stack);
+	jary->stack = aligned_alloc(64, stacksz);
+
+	jry_dlclose(jary->native_so);
+	jary->native_so = NULL;
+	jary->native	= NULL;
+
+	if (jary->stack == NULL)
+		goto OUT_OF_MEMORY;
+
 	goto FINISH;
 
 COMPILE_FAIL: {
@@ -1024,107 +1559,1137 @@ int jary_output_bool(const struct jyOutput *output,
 	return JARY_OK;
 }
 
-int jary_rule_clbk(struct jary *jary,
-		   const char  *name,
-		   int (*callback)(void *, const struct jyOutput *),
-		   void *data)
+void jary_batch_len(const struct jyBatch *batch, unsigned int *rows)
 {
-	uint32_t	ordinal = 0;
-	struct jy_defs *names	= jary->code->jay->names;
-	union jy_value	view;
-	enum jy_ktype	type;
-
-	if (def_get(names, name, &view, &type))
-		return JARY_ERR_NOTEXIST;
+	*rows = batch->size;
+}
 
-	if (type != JY_K_RULE)
+int jary_batch_str(const struct jyBatch *batch,
+		   unsigned int		 column,
+		   const char *const   **strs,
+		   const unsigned int  **lens)
+{
+	if (column >= batch->width || batch->cols[column].type != JY_K_STR)
 		return JARY_ERR_NOTEXIST;
 
-	ordinal = view.ofs;
+	*strs = batch->cols[column].values;
+	*lens = batch->cols[column].lens;
 
-	jry_mem_push(jary->r_clbks, jary->r_clbk_sz, callback);
+	return JARY_OK;
+}
 
-	if (jary->r_clbks == NULL)
-		return JARY_ERR_OOM;
+int jary_batch_long(const struct jyBatch *batch,
+		    unsigned int	  column,
+		    const long		**values)
+{
+	if (column >= batch->width)
+		return JARY_ERR_NOTEXIST;
 
-	jry_mem_push(jary->r_clbk_ords, jary->r_clbk_sz, ordinal);
+	switch (batch->cols[column].type) {
+	case JY_K_LONG:
+	case JY_K_ULONG:
+		*values = batch->cols[column].values;
+		return JARY_OK;
+	default:
+		return JARY_ERR_NOTEXIST;
+	}
+}
 
-	if (jary->r_clbk_ords == NULL)
-		return JARY_ERR_OOM;
+int jary_batch_ulong(const struct jyBatch *batch,
+		     unsigned int	   column,
+		     const unsigned long **values)
+{
+	return jary_batch_long(batch, column, (const long **) values);
+}
 
-	jry_mem_push(jary->r_clbk_datas, jary->r_clbk_sz, data);
+int jary_batch_bool(const struct jyBatch  *batch,
+		    unsigned int	   column,
+		    const unsigned char **values)
+{
+	if (column >= batch->width || batch->cols[column].type != JY_K_BOOL)
+		return JARY_ERR_NOTEXIST;
 
-	if (jary->r_clbk_datas == NULL)
-		return JARY_ERR_OOM;
+	*values = batch->cols[column].values;
 
-	jary->r_clbk_sz += 1;
 	return JARY_OK;
 }
 
-int jary_execute(struct jary *jary)
+static void batch_free(struct jyBatch *b)
 {
-	assert(jary->code != NULL);
+	for (unsigned int i = 0; b->cols && i < b->width; ++i) {
+		free(b->cols[i].values);
+		free(b->cols[i].lens);
+	}
 
-	int ret = JARY_OK;
+	free(b->cols);
+	sa_free(&b->strs);
 
-	const struct jy_jay *jay    = jary->code->jay;
-	struct sc_mem	     sc	    = { .buf = NULL };
-	struct sb_mem	     outmem = { .buf = NULL };
+	b->cols	 = NULL;
+	b->width = 0;
+	b->size	 = 0;
+}
 
-	if (sc_reap(&sc, &outmem, (free_t) sb_free))
-		goto OUT_OF_MEMORY;
+// collect the ordinals of the rules matched by name into ords, a trailing
+// '*' matches every rule starting with what precedes it
+static uint32_t find_rules(const struct jy_defs *names,
+			   const char		 *name,
+			   uint16_t		 *ords)
+{
+	uint32_t sz  = 0;
+	size_t	 len = strlen(name);
 
-	for (unsigned int i = 0; i < jary->ev_sz; ++i) {
-		const char  *table = jary->ev_tables[i];
-		const char **cols  = jary->ev_cols[i];
-		const char **vals  = jary->ev_vals[i];
-		uint8_t	     colsz = jary->ev_colsz[i];
+	if (len == 0 || name[len - 1] != '*') {
+		uint32_t id;
 
-		int sz = prinsevt(0, NULL, table, colsz, cols, vals);
+		if (!def_find(names, name, &id))
+			return 0;
 
-		char *sql = sc_alloc(&sc, sz);
+		if (names->types[id] != JY_K_RULE)
+			return 0;
 
-		if (sql == NULL)
-			goto OUT_OF_MEMORY;
+		ords[0] = names->vals[id].ofs;
+		return 1;
+	}
 
-		prinsevt(sz, sql, table, colsz, cols, vals);
+	for (uint32_t i = 0; i < names->capacity; ++i) {
+		const char *key = names->keys[i];
 
-		switch (sqlite3_exec(jary->db, sql, NULL, NULL, NULL)) {
-		case SQLITE_OK:
-			break;
-		default:
-			goto INSERT_FAIL;
-		}
-	}
+		if (key == NULL || names->types[i] != JY_K_RULE)
+			continue;
 
-	const uint16_t *ords   = jary->r_clbk_ords;
-	void *const    *datas  = jary->r_clbk_datas;
-	size_t		clbksz = jary->r_clbk_sz;
-	int (*const *clbks)(void *, const struct jyOutput *) = jary->r_clbks;
+		if (strncmp(key, name, len - 1) != 0)
+			continue;
 
-	for (size_t i = 0; i < jay->rulesz; ++i) {
-		struct jy_state state = { .lifetime = &sc, .outm = &outmem };
+		ords[sz] = names->vals[i].ofs;
+		sz	+= 1;
+	}
+
+	return sz;
+}
+
+// call visit with the ordinal of every rule matched by name, when a visit
+// fails the rules visited before it are handed back to undo
+static int each_rule(struct jary *jary,
+		     const char	 *name,
+		     int (*visit)(struct jary *, uint16_t, void *),
+		     void (*undo)(struct jary *, uint16_t, void *),
+		     void *data)
+{
+	int		     ret  = JARY_OK;
+	const struct jy_jay *jay  = jary->code->jay;
+	uint16_t	    *ords = malloc(sizeof(*ords) * (jay->rulesz + 1));
+	uint32_t	     i	  = 0;
+
+	if (ords == NULL)
+		goto OUT_OF_MEMORY;
+
+	uint32_t ordsz = find_rules(jay->names, name, ords);
+
+	if (ordsz == 0)
+		goto NOT_EXIST;
+
+	if (jary->r_disp == NULL)
+		jary->r_disp = calloc(jay->rulesz + 1, sizeof(*jary->r_disp));
+
+	if (jary->r_disp == NULL)
+		goto OUT_OF_MEMORY;
+
+	for (; i < ordsz; ++i) {
+		ret = visit(jary, ords[i], data);
+
+		if (ret != JARY_OK)
+			goto UNDO;
+	}
+
+	goto FINISH;
+
+UNDO:
+	while (undo != NULL && i-- > 0)
+		undo(jary, ords[i], data);
+
+	goto FINISH;
+
+NOT_EXIST:
+	ret = JARY_ERR_NOTEXIST;
+	goto FINISH;
+
+OUT_OF_MEMORY:
+	ret = JARY_ERR_OOM;
+
+FINISH:
+	free(ords);
+	return ret;
+}
+
+static int visit_clbk(struct jary *jary, uint16_t rule, void *data)
+{
+	struct rule_disp *disp = &jary->r_disp[rule];
+
+	jry_mem_push(disp->clbks, disp->clbksz, *(uint16_t *) data);
+
+	if (disp->clbks == NULL)
+		return JARY_ERR_OOM;
+
+	disp->clbksz += 1;
+	return JARY_OK;
+}
+
+static void undo_clbk(struct jary *jary, uint16_t rule, void *data)
+{
+	(void) data;
+	jary->r_disp[rule].clbksz -= 1;
+}
+
+static int add_clbk(struct jary *jary,
+		    const char	*name,
+		    int (*callback)(void *, const struct jyOutput *),
+		    void *data,
+		    bool  row)
+{
+	uint16_t idx = 0;
+
+	// take the slot of a callback no rule calls anymore
+	while (idx < jary->r_clbk_sz && jary->r_clbks[idx] != NULL)
+		idx += 1;
+
+	if (idx == jary->r_clbk_sz) {
+		jry_mem_push(jary->r_clbks, jary->r_clbk_sz, NULL);
+
+		if (jary->r_clbks == NULL)
+			return JARY_ERR_OOM;
+
+		jry_mem_push(jary->r_clbk_datas, jary->r_clbk_sz, NULL);
+
+		if (jary->r_clbk_datas == NULL)
+			return JARY_ERR_OOM;
+
+		jry_mem_push(jary->r_clbk_rows, jary->r_clbk_sz, false);
+
+		if (jary->r_clbk_rows == NULL)
+			return JARY_ERR_OOM;
+	}
+
+	jary->r_clbks[idx]	= callback;
+	jary->r_clbk_datas[idx] = data;
+	jary->r_clbk_rows[idx]	= row;
+
+	int ret = each_rule(jary, name, visit_clbk, undo_clbk, &idx);
+
+	if (ret != JARY_OK)
+		jary->r_clbks[idx] = NULL;
+	else if (idx == jary->r_clbk_sz)
+		jary->r_clbk_sz += 1;
+
+	return ret;
+}
+
+int jary_rule_clbk(struct jary *jary,
+		   const char  *name,
+		   int (*callback)(void *, const struct jyOutput *),
+		   void *data)
+{
+	return add_clbk(jary, name, callback, data, false);
+}
+
+int jary_rule_stream(struct jary *jary,
+		     const char	 *name,
+		     int (*callback)(void *, const struct jyOutput *),
+		     void *data)
+{
+	return add_clbk(jary, name, callback, data, true);
+}
+
+struct batch_visit {
+	unsigned int rows;
+	int (*callback)(void *, const struct jyBatch *);
+	void *data;
+};
+
+static int visit_batch(struct jary *jary, uint16_t rule, void *data)
+{
+	const struct batch_visit *v	= data;
+	const struct jy_jay	 *jay	= jary->code->jay;
+	const enum jy_ktype	 *types = jay->outtypes + jay->ruleoofs[rule];
+	struct rule_disp	 *disp	= &jary->r_disp[rule];
+	struct rule_batch	  b	= {
+			 .callback = v->callback,
+			 .data	   = v->data,
+	};
+
+	b.batch.capacity = v->rows;
+	b.batch.width	 = jay->ruleosz[rule];
+	b.batch.cols	 = calloc(b.batch.width + 1, sizeof(*b.batch.cols));
+
+	if (b.batch.cols == NULL)
+		goto OUT_OF_MEMORY;
+
+	for (unsigned int i = 0; i < b.batch.width; ++i) {
+		struct jyColumn *col = &b.batch.cols[i];
+		size_t		 sz  = sizeof(long);
+
+		col->type = types[i];
+
+		if (col->type == JY_K_BOOL)
+			sz = sizeof(unsigned char);
+
+		if (col->type == JY_K_STR) {
+			sz	  = sizeof(const char *);
+			col->lens = malloc(sizeof(*col->lens) * v->rows);
+
+			if (col->lens == NULL)
+				goto OUT_OF_MEMORY;
+		}
+
+		col->values = malloc(sz * v->rows);
+
+		if (col->values == NULL)
+			goto OUT_OF_MEMORY;
+	}
+
+	uint16_t k = 0;
+
+	// take the slot of an unregistered batch
+	while (k < jary->r_batch_sz && jary->r_batches[k].callback != NULL)
+		k += 1;
+
+	jry_mem_push(disp->batches, disp->batchsz, k);
+
+	if (disp->batches == NULL)
+		goto OUT_OF_MEMORY;
+
+	if (k == jary->r_batch_sz) {
+		jry_mem_push(jary->r_batches, jary->r_batch_sz, b);
+
+		if (jary->r_batches == NULL)
+			goto OUT_OF_MEMORY;
+
+		jary->r_batch_sz += 1;
+	}
+
+	jary->r_batches[k]  = b;
+	disp->batchsz	   += 1;
+	return JARY_OK;
+
+OUT_OF_MEMORY:
+	batch_free(&b.batch);
+	return JARY_ERR_OOM;
+}
+
+// frees the batch in slot k for the next registration to take
+static void batch_release(struct jary *jary, uint16_t k)
+{
+	batch_free(&jary->r_batches[k].batch);
+	jary->r_batches[k].callback = NULL;
+}
+
+static void undo_batch(struct jary *jary, uint16_t rule, void *data)
+{
+	struct rule_disp *disp = &jary->r_disp[rule];
+
+	(void) data;
+	disp->batchsz -= 1;
+	batch_release(jary, disp->batches[disp->batchsz]);
+}
+
+int jary_rule_batch_clbk(struct jary *jary,
+			 const char  *name,
+			 unsigned int rows,
+			 int (*callback)(void *, const struct jyBatch *),
+			 void *data)
+{
+	struct batch_visit v = {
+		.rows	  = rows,
+		.callback = callback,
+		.data	  = data,
+	};
+
+	if (rows == 0)
+		return JARY_ERROR;
+
+	// outputs differ between rules, every match gets its own batch
+	return each_rule(jary, name, visit_batch, undo_batch, &v);
+}
+
+struct sink_visit {
+	unsigned int flags;
+	uint16_t     sink;
+};
+
+static int visit_sink(struct jary *jary, uint16_t rule, void *data)
+{
+	const struct sink_visit *v    = data;
+	const struct jy_jay	*jay  = jary->code->jay;
+	struct rule_disp	*disp = &jary->r_disp[rule];
+	struct rule_sink	 rs   = {
+			.time = v->flags & JARY_SINK_TIME,
+			.sink = v->sink,
+	};
+
+	if (v->flags & JARY_SINK_RULE)
+		rs.rule = jay->names->keys[jay->rulenids[rule]];
+
+	jry_mem_push(jary->r_rsinks, jary->r_rsink_sz, rs);
+
+	if (jary->r_rsinks == NULL)
+		return JARY_ERR_OOM;
+
+	jry_mem_push(disp->sinks, disp->sinksz, jary->r_rsink_sz);
+
+	if (disp->sinks == NULL)
+		return JARY_ERR_OOM;
+
+	jary->r_rsink_sz += 1;
+	disp->sinksz	 += 1;
+	return JARY_OK;
+}
+
+static void undo_sink(struct jary *jary, uint16_t rule, void *data)
+{
+	(void) data;
+	jary->r_disp[rule].sinksz -= 1;
+	jary->r_rsink_sz	  -= 1;
+}
+
+int jary_rule_sink(struct jary *jary,
+		   const char  *name,
+		   int		fd,
+		   unsigned int flags)
+{
+	uint16_t	  sinksz = jary->r_sink_sz;
+	struct sink_visit v	 = { .flags = flags, .sink = 0 };
+
+	if ((flags & 0xff) != JARY_SINK_NDJSON || fd < 0)
+		return JARY_ERROR;
+
+	while (v.sink < jary->r_sink_sz && jary->r_sinks[v.sink].fd != fd)
+		v.sink += 1;
+
+	if (v.sink == jary->r_sink_sz) {
+		struct jy_sink out = { .fd = fd };
+
+		jry_mem_push(jary->r_sinks, jary->r_sink_sz, out);
+
+		if (jary->r_sinks == NULL)
+			return JARY_ERR_OOM;
+
+		jary->r_sink_sz += 1;
+	}
+
+	int ret = each_rule(jary, name, visit_sink, undo_sink, &v);
+
+	if (ret != JARY_OK)
+		jary->r_sink_sz = sinksz;
+
+	return ret;
+}
+
+int jary_ring(struct jary *jary, unsigned int slots, unsigned int slotsz)
+{
+	if (jary->ring != NULL || slots == 0 || slotsz < 64)
+		return JARY_ERROR;
+
+	if (jry_ring_new(&jary->ring, slots, slotsz))
+		return JARY_ERR_OOM;
+
+	return JARY_OK;
+}
+
+static int visit_ring(struct jary *jary, uint16_t rule, void *data)
+{
+	(void) data;
+	jary->r_disp[rule].ring = true;
+	return JARY_OK;
+}
+
+int jary_rule_ring(struct jary *jary, const char *name)
+{
+	if (jary->ring == NULL)
+		return JARY_ERROR;
+
+	return each_rule(jary, name, visit_ring, NULL, NULL);
+}
+
+static int visit_limit(struct jary *jary, uint16_t rule, void *data)
+{
+	jary->r_limits[rule] = *(const struct rule_limit *) data;
+	return JARY_OK;
+}
+
+int jary_rule_limit(struct jary  *jary,
+		    const char	 *name,
+		    unsigned long ops,
+		    unsigned long rows,
+		    unsigned long msec)
+{
+	struct rule_limit limit = {
+		.ops  = ops,
+		.rows = rows,
+		.nsec = (uint64_t) msec * 1000000u,
+	};
+
+	if (jary->r_limits == NULL)
+		jary->r_limits = calloc(jary->code->jay->rulesz + 1,
+					sizeof(*jary->r_limits));
+
+	if (jary->r_limits == NULL)
+		return JARY_ERR_OOM;
+
+	return each_rule(jary, name, visit_limit, NULL, &limit);
+}
+
+void jary_interrupt(struct jary *jary)
+{
+	atomic_store_explicit(&jary->interrupt, true, memory_order_relaxed);
+	sqlite3_interrupt(jary->db);
+}
+
+void jary_profile(struct jary *jary, unsigned char enable)
+{
+	jary->profile = enable;
+}
+
+int jary_latency(struct jary *jary, unsigned char enable)
+{
+	if (jary->r_stats == NULL) {
+		jary->errmsg = "missing code in context";
+		return JARY_ERR_NOTEXIST;
+	}
+
+	size_t rulesz = jary->code->jay->rulesz;
+
+	if (jary->r_hists == NULL)
+		jary->r_hists = calloc(rulesz + 1, sizeof(*jary->r_hists));
+
+	if (jary->r_hists == NULL)
+		return JARY_ERR_OOM;
+
+	jary->latency = enable;
+
+	return JARY_OK;
+}
+
+struct hist_visit {
+	uint64_t *counts;
+	uint64_t  total;
+};
+
+static int visit_hist(struct jary *jary, uint16_t rule, void *data)
+{
+	struct hist_visit *v = data;
+
+	if (jary->r_hists != NULL)
+		v->total += jry_hist_merge(v->counts, &jary->r_hists[rule]);
+
+	return JARY_OK;
+}
+
+int jary_latency_histogram(struct jary	    *jary,
+			   const char	    *name,
+			   struct jyLatency *latency)
+{
+	if (jary->r_stats == NULL) {
+		jary->errmsg = "missing code in context";
+		return JARY_ERR_NOTEXIST;
+	}
+
+	struct hist_visit v = {
+		.counts = calloc(JRY_HISTSIZE, sizeof(*v.counts)),
+		.total	= 0,
+	};
+
+	if (v.counts == NULL)
+		return JARY_ERR_OOM;
+
+	int ret = each_rule(jary, name, visit_hist, NULL, &v);
+
+	if (ret == JARY_OK) {
+		latency->count = v.total;
+		latency->p50   = jry_hist_quantile(v.counts, v.total, 500000);
+		latency->p99   = jry_hist_quantile(v.counts, v.total, 990000);
+		latency->p999  = jry_hist_quantile(v.counts, v.total, 999000);
+		latency->max   = jry_hist_quantile(v.counts, v.total, 1000000);
+	}
+
+	free(v.counts);
+	return ret;
+}
+
+int jary_stats(struct jary *jary, struct jyStats *stats)
+{
+	if (jary->r_stats == NULL) {
+		jary->errmsg = "missing code in context";
+		return JARY_ERR_NOTEXIST;
+	}
+
+	*stats = jary->stats;
+
+	return JARY_OK;
+}
+
+int jary_poll_matches(struct jary *jary,
+		      unsigned int max,
+		      int (*clbk)(void *,
+				  const char *,
+				  const struct jyOutput *),
+		      void	   *data,
+		      unsigned int *polled)
+{
+	const struct jy_jay *jay   = jary->code->jay;
+	unsigned int	     count = 0;
+	uint16_t	     rule;
+	union jy_value	    *values;
+	uint32_t	     size;
+
+	if (jary->ring == NULL)
+		return JARY_ERROR;
+
+	while (count < max
+	       && jry_ring_peek(jary->ring, &rule, &values, &size)) {
+		uint16_t	nid    = jay->rulenids[rule];
+		struct jyOutput output = { .size = size, .values = values };
+
+		int ret = clbk(data, jay->names->keys[nid], &output);
+
+		jry_ring_pop(jary->ring);
+		count += 1;
+
+		if (ret == JARY_INT_FINAL)
+			break;
+	}
+
+	if (polled != NULL)
+		*polled = count;
+
+	return JARY_OK;
+}
+
+void jary_ring_overflow(struct jary *jary, unsigned long *count)
+{
+	*count = jary->ring ? jry_ring_overflow(jary->ring) : 0;
+}
+
+// whether a rule still calls the callback in slot c
+static bool clbk_used(const struct jary *jary, uint16_t c)
+{
+	for (size_t i = 0; i < jary->code->jay->rulesz; ++i) {
+		const struct rule_disp *disp = &jary->r_disp[i];
+
+		for (uint16_t j = 0; j < disp->clbksz; ++j)
+			if (disp->clbks[j] == c)
+				return true;
+	}
+
+	return false;
+}
+
+struct unclbk_visit {
+	int (*callback)(void *, const struct jyOutput *);
+	void *data;
+	bool  removed;
+};
+
+static int visit_unclbk(struct jary *jary, uint16_t rule, void *data)
+{
+	struct unclbk_visit *v	  = data;
+	struct rule_disp    *disp = &jary->r_disp[rule];
+	uint16_t	     kept = 0;
+
+	for (uint16_t j = 0; j < disp->clbksz; ++j) {
+		uint16_t c = disp->clbks[j];
+
+		if (jary->r_clbks[c] == v->callback
+		    && jary->r_clbk_datas[c] == v->data) {
+			v->removed = true;
+			continue;
+		}
+
+		disp->clbks[kept] = c;
+		kept		 += 1;
+	}
+
+	disp->clbksz = kept;
+	return JARY_OK;
+}
+
+int jary_rule_unclbk(struct jary *jary,
+		     const char	 *name,
+		     int (*callback)(void *, const struct jyOutput *),
+		     void *data)
+{
+	struct unclbk_visit v = {
+		.callback = callback,
+		.data	  = data,
+		.removed  = false,
+	};
+
+	int ret = each_rule(jary, name, visit_unclbk, NULL, &v);
+
+	if (ret == JARY_OK && !v.removed)
+		ret = JARY_ERR_NOTEXIST;
+
+	// free the slots no rule calls anymore for add_clbk() to take
+	for (uint16_t c = 0; ret == JARY_OK && c < jary->r_clbk_sz; ++c) {
+		if (jary->r_clbks[c] != callback
+		    || jary->r_clbk_datas[c] != data || clbk_used(jary, c))
+			continue;
+
+		jary->r_clbks[c] = NULL;
+	}
+
+	return ret;
+}
+
+struct batch_unclbk_visit {
+	int (*callback)(void *, const struct jyBatch *);
+	void *data;
+	bool  removed;
+};
+
+static int visit_batch_unclbk(struct jary *jary, uint16_t rule, void *data)
+{
+	struct batch_unclbk_visit *v	= data;
+	struct rule_disp	  *disp = &jary->r_disp[rule];
+	uint16_t		   kept = 0;
+
+	for (uint16_t j = 0; j < disp->batchsz; ++j) {
+		uint16_t	   k = disp->batches[j];
+		struct rule_batch *b = &jary->r_batches[k];
+
+		if (b->callback == v->callback && b->data == v->data) {
+			batch_release(jary, k);
+			v->removed = true;
+			continue;
+		}
+
+		disp->batches[kept]  = k;
+		kept		    += 1;
+	}
+
+	disp->batchsz = kept;
+	return JARY_OK;
+}
+
+int jary_rule_batch_unclbk(struct jary *jary,
+			   const char  *name,
+			   int (*callback)(void *, const struct jyBatch *),
+			   void *data)
+{
+	struct batch_unclbk_visit v = {
+		.callback = callback,
+		.data	  = data,
+		.removed  = false,
+	};
+
+	int ret = each_rule(jary, name, visit_batch_unclbk, NULL, &v);
+
+	if (ret == JARY_OK && !v.removed)
+		ret = JARY_ERR_NOTEXIST;
+
+	return ret;
+}
+
+int jary_rule_plan(struct jary *jary, const char *name, char **text)
+{
+	const struct jy_jay *jay = jary->code->jay;
+
+	if (jay == NULL) {
+		jary->errmsg = "missing code in context";
+		return JARY_ERR_NOTEXIST;
+	}
+
+	int		ret    = JARY_OK;
+	struct sc_mem	sc     = { .buf = NULL };
+	struct sb_mem	outmem = { .buf = NULL };
+	union jy_value	view;
+	enum jy_ktype	type;
+
+	if (def_get(jay->names, name, &view, &type) || type != JY_K_RULE) {
+		jary->errmsg = "rule does not exist";
+		return JARY_ERR_NOTEXIST;
+	}
+
+	struct jy_state state = {
+		.lifetime = &sc,
+		.outm	  = &outmem,
+		.stack	  = jary->stack,
+		.window	  = jary->window,
+		.tiered	  = jary->tiered,
+	};
+
+	uint8_t *code = jay->codes + jay->rulecofs[view.ofs];
+
+	switch (jry_plan(jary->db, jay, code, &state, text)) {
+	case 0:
+		jary->errmsg = "not an error";
+
+		// removed by the compiler, there is no query to explain
+		if (*text != NULL)
+			break;
+
+		*text = strdup("no query, the condition is never true\n");
+
+		if (*text != NULL)
+			break;
+		// fall through
+	case 1:
+		jary->errmsg = "out of memory";
+		ret	     = JARY_ERR_OOM;
+		break;
+	default:
+		jary->errmsg = sqlite3_errmsg(jary->db);
+		ret	     = JARY_ERR_SQLITE3;
+		break;
+	}
+
+	sb_free(&outmem);
+	sc_free(&sc);
+	return ret;
+}
+
+int jary_native_source(struct jary *jary, char **text)
+{
+	const struct jy_jay *jay = jary->code->jay;
+
+	if (jay == NULL) {
+		jary->errmsg = "missing code in context";
+		return JARY_ERR_NOTEXIST;
+	}
+
+	int   bufsz = jry_emit_c(0, NULL, jay) + 1;
+	char *buf   = malloc(bufsz);
+
+	if (buf == NULL) {
+		jary->errmsg = "out of memory";
+		return JARY_ERR_OOM;
+	}
+
+	jry_emit_c(bufsz, buf, jay);
+	*text = buf;
+
+	return JARY_OK;
+}
+
+int jary_native(struct jary *jary, const char *path)
+{
+	const struct jy_jay *jay = jary->code->jay;
+
+	if (jay == NULL) {
+		jary->errmsg = "missing code in context";
+		return JARY_ERR_NOTEXIST;
+	}
+
+	void		      *handle;
+	jy_native_rule *const *rules;
+	uint64_t	       hash = jry_hash(jay);
+
+	switch (jry_dlnative(path, hash, jay->rulesz, &handle, &rules,
+			     &jary->errmsg)) {
+	case 0:
+		break;
+	case 4:
+		return JARY_ERR_MISMATCH;
+	default:
+		return JARY_ERROR;
+	}
+
+	jry_dlclose(jary->native_so);
+	jary->native_so = handle;
+	jary->native	= rules;
+	jary->errmsg	= "not an error";
+
+	return JARY_OK;
+}
+
+int jary_execute(struct jary *jary)
+{
+	assert(jary->code != NULL);
+
+	int ret = JARY_OK;
+
+	const struct jy_jay *jay    = jary->code->jay;
+	struct sc_mem	     sc	    = { .buf = NULL };
+	struct sb_mem	     outmem = { .buf = NULL };
+	struct sb_mem	     ingmem = { .buf = NULL };
+	// queued events inserted, the others stay queued
+	uint32_t	     done   = jary->ev_sz;
+	// nothing was queued, every row was recorded already
+	uint64_t	     since  = jary->ev_ingest ? jary->ev_ingest
+						      : UINT64_MAX;
+
+	// an interrupt only stops the execution it arrives during
+	atomic_store_explicit(&jary->interrupt, false, memory_order_relaxed);
+
+	bool	 profile = jary->profile;
+	uint64_t start	 = profile ? jry_monotonic() : 0;
+
+	jary->stats.executions += 1;
+
+	if (sc_reap(&sc, &outmem, (free_t) sb_free))
+		goto OUT_OF_MEMORY;
+
+	if (sc_reap(&sc, &ingmem, (free_t) sb_free))
+		goto OUT_OF_MEMORY;
+
+	const char *schema = jary->tiered ? "hot" : "main";
+
+	for (unsigned int i = 0; i < jary->ev_sz; ++i) {
+		const char  *table = jary->ev_tables[i];
+		const char **cols  = jary->ev_cols[i];
+		const char **vals  = jary->ev_vals[i];
+		uint8_t	     colsz = jary->ev_colsz[i];
+
+		int sz = prinsevt(0, NULL, schema, table, colsz, cols, vals);
+
+		char *sql = sc_alloc(&sc, sz);
+
+		if (sql == NULL)
+			goto OUT_OF_MEMORY;
+
+		prinsevt(sz, sql, schema, table, colsz, cols, vals);
+
+		switch (sqlite3_exec(jary->db, sql, NULL, NULL, NULL)) {
+		case SQLITE_OK:
+			break;
+		case SQLITE_INTERRUPT:
+			done = i;
+			goto INTERRUPTED;
+		default:
+			goto INSERT_FAIL;
+		}
+	}
+
+	if (profile)
+		jary->stats.insert_ns += jry_monotonic() - start;
+
+	if (jary->tiered && migrate(jary, &sc))
+		goto MIGRATE_FAIL;
+
+	// nothing holds the row strings of the last run, make room for new
+	// values once the table filled up
+	if (jary->strs.full)
+		jry_intern_reset(&jary->strs, false);
+
+	sa_reset(&jary->arena);
+
+	void *const    *datas  = jary->r_clbk_datas;
+	const bool     *rows   = jary->r_clbk_rows;
+	size_t		clbksz = jary->r_clbk_sz;
+	bool	       *final  = sc_alloc(&sc, clbksz + 1);
+	int (*const *clbks)(void *, const struct jyOutput *) = jary->r_clbks;
+
+	if (final == NULL)
+		goto OUT_OF_MEMORY;
+
+	struct rule_batch *batches = jary->r_batches;
+	size_t		   batchsz = jary->r_batch_sz;
+
+	for (size_t j = 0; j < batchsz; ++j)
+		batches[j].final = false;
+
+	const struct rule_disp	none	= { .clbksz = 0 };
+	struct rule_limit	nolimit = { .ops = 0 };
+	long			now	= time(NULL);
+	bool			limited = false;
+	int (*stream)(void *, const union jy_value *, uint32_t) =
+		profile ? timed_row_clbks : row_clbks;
+
+	for (size_t i = 0; i < jay->rulesz; ++i) {
+		const struct rule_disp *disp = jary->r_disp ? &jary->r_disp[i]
+							    : &none;
+		struct rule_limit *limit = jary->r_limits ? &jary->r_limits[i]
+							  : &nolimit;
+
+		if (atomic_load_explicit(&jary->interrupt,
+					 memory_order_relaxed))
+			goto INTERRUPTED;
+
+		// nobody consumes what the rule outputs
+		if (!disp->clbksz && !disp->batchsz && !disp->sinksz
+		    && !disp->ring && !jay->ruleact[i])
+			continue;
+
+		struct jyRuleStats *stats  = &jary->r_stats[i];
+		stats->runs		  += 1;
+
+		bool byrow  = disp->batchsz || disp->sinksz || disp->ring;
+		bool byrule = false;
+
+		for (size_t j = 0; j < disp->clbksz; ++j) {
+			uint16_t c = disp->clbks[j];
+
+			byrow	 |= rows[c];
+			byrule	 |= !rows[c];
+			final[c]  = false;
+		}
+
+		struct jy_suppress *supp = jary->r_supps ? jary->r_supps[i]
+							 : NULL;
+		struct jy_hist	   *hist = jary->latency ? &jary->r_hists[i]
+							 : NULL;
+
+		// rows that wait for the end of the rule keep their ingest
+		ingmem.size = 0;
+
+		struct row_clbks rowc = {
+			.disp	 = disp,
+			.datas	 = datas,
+			.rows	 = rows,
+			.clbks	 = clbks,
+			.final	 = final,
+			.batches = batches,
+			.sinks	 = jary->r_sinks,
+			.rsinks	 = jary->r_rsinks,
+			.ring	 = jary->ring,
+			.rule	 = i,
+			.types	 = jay->outtypes + jay->ruleoofs[i],
+			.time	 = now,
+			.hist	 = hist,
+			.since	 = since,
+		};
+
+		uint64_t deadline = 0;
+
+		if (limit->nsec)
+			deadline = jry_monotonic() + limit->nsec;
+
+		struct jy_state state = {
+			.lifetime   = &sc,
+			.outm	    = &outmem,
+			.stack	    = jary->stack,
+			.native	    = jary->native,
+			.strs	    = &jary->strs,
+			.arena	    = &jary->arena,
+			.stream	    = byrow && !supp ? stream : NULL,
+			.streamdata = &rowc,
+			.streamonly = !byrule && !supp,
+			.window	    = jary->window,
+			.tiered	    = jary->tiered,
+			.maxops	    = limit->ops,
+			.maxrows    = limit->rows,
+			.deadline   = deadline,
+			.profile    = profile,
+			.latency    = hist != NULL,
+			.ingm	    = hist && (byrule || supp) ? &ingmem : NULL,
+		};
 		size_t		ofs   = jay->rulecofs[i];
 		uint8_t	       *code  = jay->codes + ofs;
 
-		switch (jry_exec(jary->db, jay, code, &state)) {
+		rowc.ingest = &state.ingest;
+
+		start	   = profile ? jry_monotonic() : 0;
+		int status = jry_exec(jary->db, jay, code, &state);
+
+		if (profile) {
+			uint64_t spent = jry_monotonic() - start;
+			uint64_t other = state.prof[0] + state.prof[1]
+				       + rowc.clbkns;
+
+			// whatever the query and stream did not take
+			spent = spent > other ? spent - other : 0;
+
+			stats->prepare_ns   += state.prof[0];
+			stats->step_ns	    += state.prof[1];
+			stats->interpret_ns += spent;
+		}
+
+		uint16_t width = jay->ruleosz[i];
+
+		// suppressed rows are handed out here, count it as callbacks
+		start = profile ? jry_monotonic() : 0;
+
+		if (status == 0 && supp
+		    && suppress_rows(supp, &rowc, &state, width, byrow))
+			status = 2;
+
+		if (profile && supp)
+			rowc.clbkns += jry_monotonic() - start;
+
+		stats->rows += state.rows;
+		stats->ops  += state.ops;
+
+		if (byrow)
+			stats->matches += rowc.matches;
+		else if (status == 0 && width)
+			stats->matches += state.outsz / width;
+
+		switch (status) {
 		case 1:
 			goto OUT_OF_MEMORY;
 		case 2:
+			// a row callback crashed the runtime
+			if (rowc.crash)
+				goto FINISH;
+
+			if (rowc.oom)
+				goto OUT_OF_MEMORY;
+
+			if (rowc.sinkerr)
+				goto SINK_FAIL;
+
+			if (atomic_load_explicit(&jary->interrupt,
+						 memory_order_relaxed))
+				goto INTERRUPTED;
+
 			goto QUERY_FAILED;
+		case 3:
+			// streamed rows are out, the partial output is not
+			stats->callback_ns += rowc.clbkns;
+			stats->limits	   += 1;
+			limited		    = true;
+			continue;
+		case 4:
+			goto BAD_CODE;
 		}
 
+		start = profile ? jry_monotonic() : 0;
+
 		struct jyOutput output = {
 			.size	= state.outsz,
 			.values = state.out,
 		};
 
-		switch (rule_clbks(i, &output, clbksz, ords, datas, clbks)) {
-		case JARY_INT_CRASH:
-			goto FINISH;
-		};
+		// rows streamed were recorded as they went out
+		if (byrule && !byrow && hist)
+			record_rows(hist, &state, width, since);
+
+		if (byrule) {
+			switch (rule_clbks(disp, &output, datas, rows, clbks)) {
+			case JARY_INT_CRASH:
+				goto FINISH;
+			};
+		}
+
+		if (profile)
+			rowc.clbkns += jry_monotonic() - start;
+
+		stats->callback_ns += rowc.clbkns;
 	}
 
+	// every rule saw the inserted events
+	jary->ev_ingest = 0;
+
+	// what is left of every batch goes out with the execution
+	for (size_t j = 0; j < batchsz; ++j)
+		if (batch_flush(&batches[j]) == JARY_INT_CRASH)
+			goto FINISH;
+
+	for (size_t j = 0; j < jary->r_sink_sz; ++j)
+		if (jry_sink_flush(&jary->r_sinks[j]))
+			goto SINK_FAIL;
+
+	if (limited)
+		goto LIMITED;
+
+	goto FINISH;
+
+LIMITED:
+	jary->errmsg = "a rule exceeded its budget";
+	ret	     = JARY_ERR_LIMIT;
+	goto FINISH;
+
+INTERRUPTED:
+	jary->errmsg = "execution interrupted";
+	ret	     = JARY_ERR_INTR;
 	goto FINISH;
 
 OUT_OF_MEMORY:
@@ -1137,17 +2702,46 @@ INSERT_FAIL:
 	ret	     = JARY_ERR_EXEC;
 	goto FINISH;
 
+MIGRATE_FAIL:
+	jary->errmsg = "unable to migrate aged events";
+	ret	     = JARY_ERR_SQLITE3;
+	goto FINISH;
+
+SINK_FAIL:
+	jary->errmsg = "unable to write to a sink";
+	ret	     = JARY_ERROR;
+	goto FINISH;
+
 QUERY_FAILED:
 	jary->errmsg = "unable to perform query. report this bug";
 	ret	     = JARY_ERR_EXEC;
+	goto FINISH;
+
+BAD_CODE:
+	jary->errmsg = "invalid bytecode. report this bug";
+	ret	     = JARY_ERR_EXEC;
 
 FINISH:
-	for (uint32_t i = 0; i < jary->ev_sz; ++i) {
+	for (uint32_t i = 0; i < done; ++i) {
 		free(jary->ev_cols[i]);
 		free(jary->ev_vals[i]);
 	}
 
-	jary->ev_sz = 0;
+	// an interrupted insert leaves the rest for the next execution
+	uint32_t left = jary->ev_sz - done;
+
+	if (left != 0 && done != 0) {
+		memmove(jary->ev_tables, jary->ev_tables + done,
+			sizeof(*jary->ev_tables) * left);
+		memmove(jary->ev_colsz, jary->ev_colsz + done,
+			sizeof(*jary->ev_colsz) * left);
+		memmove(jary->ev_cols, jary->ev_cols + done,
+			sizeof(*jary->ev_cols) * left);
+		memmove(jary->ev_vals, jary->ev_vals + done,
+			sizeof(*jary->ev_vals) * left);
+	}
+
+	jary->ev_sz = left;
 
 	sc_free(&sc);
 	return ret;
@@ -1168,8 +2762,40 @@ int jary_close(struct jary *restrict jary)
 		free(jary->ev_vals[i]);
 	}
 
+	// the rule count is gone with the compiled code
+	for (uint32_t i = 0; jary->r_disp && i < jary->code->jay->rulesz; ++i) {
+		free(jary->r_disp[i].clbks);
+		free(jary->r_disp[i].batches);
+		free(jary->r_disp[i].sinks);
+	}
+
+	for (uint32_t i = 0; jary->r_supps && i < jary->code->jay->rulesz; ++i)
+		free(jary->r_supps[i]);
+
+	free(jary->r_supps);
+	free(jary->r_limits);
+	free(jary->r_stats);
+	free(jary->ev_stats);
+	free(jary->ev_ingress);
+	free(jary->r_hists);
+	free(jary->r_disp);
 	sc_free(&jary->sc);
 
+	for (uint32_t i = 0; i < jary->r_batch_sz; ++i)
+		batch_free(&jary->r_batches[i].batch);
+
+	free(jary->r_batches);
+
+	for (uint32_t i = 0; i < jary->r_sink_sz; ++i)
+		jry_sink_free(&jary->r_sinks[i]);
+
+	free(jary->r_sinks);
+	free(jary->r_rsinks);
+	jry_ring_free(jary->ring);
+	jry_dlclose(jary->native_so);
+	jry_intern_free(&jary->strs);
+	sa_free(&jary->arena);
+	free(jary->stack);
 	free(jary);
 
 	return JARY_OK;
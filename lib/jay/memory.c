@@ -113,6 +113,73 @@ void sb_free(struct sb_mem *sb)
 	free(sb->buf);
 }
 
+void *sa_alloc(struct sa_mem *alloc, uint32_t nmemb)
+{
+	struct sa_blk *blk  = alloc->cur;
+	struct sa_blk *tail = NULL;
+
+	nmemb = (nmemb + 7) & ~7u;
+
+	// blocks past the current one are empty since the last reset
+	for (; blk != NULL; tail = blk, blk = blk->next)
+		if (blk->size - blk->used >= nmemb)
+			break;
+
+	if (blk == NULL) {
+		uint32_t size = tail ? tail->size * 2 : 4096;
+
+		if (size < nmemb)
+			size = nmemb;
+
+		blk = malloc(sizeof(*blk) + size);
+
+		if (blk == NULL)
+			goto OUT_OF_MEMORY;
+
+		blk->next = NULL;
+		blk->size = size;
+		blk->used = 0;
+
+		if (tail == NULL)
+			alloc->head = blk;
+		else
+			tail->next = blk;
+	}
+
+	void *mem = blk->mem + blk->used;
+
+	blk->used  += nmemb;
+	alloc->cur  = blk;
+
+	return mem;
+
+OUT_OF_MEMORY:
+	return NULL;
+}
+
+void sa_reset(struct sa_mem *alloc)
+{
+	for (struct sa_blk *blk = alloc->head; blk != NULL; blk = blk->next)
+		blk->used = 0;
+
+	alloc->cur = alloc->head;
+}
+
+void sa_free(struct sa_mem *alloc)
+{
+	struct sa_blk *blk = alloc->head;
+
+	while (blk != NULL) {
+		struct sa_blk *next = blk->next;
+
+		free(blk);
+		blk = next;
+	}
+
+	alloc->head = NULL;
+	alloc->cur  = NULL;
+}
+
 void *sc_alloc(struct sc_mem *alloc, uint32_t nmemb)
 {
 	void	      *block = calloc(nmemb, 1);
@@ -51,6 +51,7 @@ TKN_INPUT:                                                                     \
 	case TKN_JUMP:                                                         \
 	case TKN_CONDITION:                                                    \
 	case TKN_FIELD:                                                        \
+	case TKN_SUPPRESS:                                                     \
 	case TKN_OUTPUT
 
 #define CASE_TKN_DECL                                                          \
@@ -617,6 +618,13 @@ static bool _section(struct parser   *p,
 		asts->types[sectast] = AST_OUTPUT_SECT;
 		listfn		     = _expr;
 		break;
+	case TKN_SUPPRESS:
+		if (decltype != AST_RULE_DECL)
+			goto INVALID_SECTION;
+
+		asts->types[sectast] = AST_SUPPRESS_SECT;
+		listfn		     = _expr;
+		break;
 	case TKN_FIELD:
 		if (decltype != AST_INGRESS_DECL)
 			goto INVALID_SECTION;
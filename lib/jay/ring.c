@@ -0,0 +1,181 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2024. Muhammad Raznan. All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "ring.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+struct ring_slot {
+	uint16_t       rule;
+	uint32_t       size;
+	union jy_value values[];
+};
+
+#define ALIGN8(n) (((n) + 7) & ~(size_t) 7)
+
+static inline struct ring_slot *slot_at(struct jy_ring *ring, uint32_t idx)
+{
+	size_t ofs = (size_t) (idx & ring->mask) * ring->slotsz;
+
+	return (struct ring_slot *) (ring->slots + ofs);
+}
+
+int jry_ring_new(struct jy_ring **ring, uint32_t slots, uint32_t slotsz)
+{
+	uint32_t count = 1;
+
+	while (count < slots)
+		count <<= 1;
+
+	slotsz = ALIGN8(slotsz);
+
+	struct jy_ring *R = aligned_alloc(64, sizeof(*R));
+
+	if (R == NULL)
+		goto OUT_OF_MEMORY;
+
+	*R = (struct jy_ring) {
+		.mask	= count - 1,
+		.slotsz = slotsz,
+	};
+
+	atomic_init(&R->tail, 0);
+	atomic_init(&R->head, 0);
+	atomic_init(&R->overflow, 0);
+
+	R->slots = aligned_alloc(64, ((size_t) count * slotsz + 63) & ~63ul);
+
+	if (R->slots == NULL)
+		goto OUT_OF_MEMORY;
+
+	*ring = R;
+
+	return 0;
+
+OUT_OF_MEMORY:
+	free(R);
+	return 1;
+}
+
+void jry_ring_free(struct jy_ring *ring)
+{
+	if (ring == NULL)
+		return;
+
+	free(ring->slots);
+	free(ring);
+}
+
+static inline void drop(struct jy_ring *ring)
+{
+	atomic_fetch_add_explicit(&ring->overflow, 1, memory_order_relaxed);
+}
+
+bool jry_ring_push(struct jy_ring	*ring,
+		   uint16_t		 rule,
+		   const union jy_value *values,
+		   const enum jy_ktype	*types,
+		   uint32_t		 size)
+{
+	uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+	if (tail - head > ring->mask)
+		goto DROP;
+
+	size_t need = sizeof(struct ring_slot) + sizeof(*values) * size;
+
+	for (uint32_t i = 0; i < size; ++i)
+		if (types[i] == JY_K_STR)
+			need += ALIGN8(sizeof(struct jy_str)
+				       + values[i].str->size + 1);
+
+	if (need > ring->slotsz)
+		goto DROP;
+
+	struct ring_slot *slot = slot_at(ring, tail);
+	char		 *strs = (char *) (slot->values + size);
+
+	slot->rule = rule;
+	slot->size = size;
+
+	for (uint32_t i = 0; i < size; ++i) {
+		slot->values[i] = values[i];
+
+		if (types[i] != JY_K_STR)
+			continue;
+
+		const struct jy_str *str = values[i].str;
+		size_t		     sz	 = sizeof(*str) + str->size + 1;
+
+		memcpy(strs, str, sz);
+
+		slot->values[i].str  = (struct jy_str *) strs;
+		strs		    += ALIGN8(sz);
+	}
+
+	// the consumer sees the slot filled once it sees the new tail
+	atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+
+	return true;
+
+DROP:
+	drop(ring);
+	return false;
+}
+
+bool jry_ring_peek(struct jy_ring  *ring,
+		   uint16_t	   *rule,
+		   union jy_value **values,
+		   uint32_t	   *size)
+{
+	uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+	if (head == tail)
+		return false;
+
+	struct ring_slot *slot = slot_at(ring, head);
+
+	*rule	= slot->rule;
+	*values = slot->values;
+	*size	= slot->size;
+
+	return true;
+}
+
+void jry_ring_pop(struct jy_ring *ring)
+{
+	uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+	atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
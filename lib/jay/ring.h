@@ -0,0 +1,81 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2024. Muhammad Raznan. All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef JAYVM_RING_H
+#define JAYVM_RING_H
+
+#include "jary/types.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Single producer single consumer ring of matched rows. The producer
+// never waits, rows are dropped and counted once the ring is full or a
+// row does not fit in a slot.
+struct jy_ring {
+	char	*slots;
+	uint32_t mask;
+	uint32_t slotsz;
+	// producer side, apart from the consumer side to not share a line
+	_Alignas(64) _Atomic uint32_t tail;
+	_Atomic unsigned long	      overflow;
+	_Alignas(64) _Atomic uint32_t head;
+};
+
+// slots is rounded up to a power of two, slotsz holds the values of a
+// row and the strings they point to
+int jry_ring_new(struct jy_ring **ring, uint32_t slots, uint32_t slotsz);
+
+void jry_ring_free(struct jy_ring *ring);
+
+// copy a row into the next slot, false if it was dropped
+bool jry_ring_push(struct jy_ring	*ring,
+		   uint16_t		 rule,
+		   const union jy_value *values,
+		   const enum jy_ktype	*types,
+		   uint32_t		 size);
+
+// oldest row not popped yet, false if the ring is empty
+bool jry_ring_peek(struct jy_ring  *ring,
+		   uint16_t	   *rule,
+		   union jy_value **values,
+		   uint32_t	   *size);
+
+// give the slot returned by jry_ring_peek() back to the producer
+void jry_ring_pop(struct jy_ring *ring);
+
+static inline unsigned long jry_ring_overflow(struct jy_ring *ring)
+{
+	return atomic_load_explicit(&ring->overflow, memory_order_relaxed);
+}
+
+#endif // JAYVM_RING_H
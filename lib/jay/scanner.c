@@ -404,6 +404,8 @@ enum jy_tkn jry_keyword(const char *ident, uint32_t length)
 	case 's':
 		if (KEYWORD(ident + 1, "tring", 5))
 			return TKN_STRING_TYPE;
+		else if (KEYWORD(ident + 1, "uppress", 7))
+			return TKN_SUPPRESS;
 
 		break;
 	}
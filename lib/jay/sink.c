@@ -0,0 +1,250 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2024. Muhammad Raznan. All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "sink.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+
+static int put(struct jy_sink *sink, const char *bytes, size_t size)
+{
+	while (size > 0) {
+		if (sink->cur == JRY_SINKIOV && jry_sink_flush(sink))
+			return 1;
+
+		uint32_t cur = sink->cur;
+
+		if (sink->chunks[cur] == NULL)
+			sink->chunks[cur] = malloc(JRY_SINKCHUNK);
+
+		if (sink->chunks[cur] == NULL)
+			return 1;
+
+		size_t room = JRY_SINKCHUNK - sink->lens[cur];
+		size_t n    = size < room ? size : room;
+
+		memcpy(sink->chunks[cur] + sink->lens[cur], bytes, n);
+
+		sink->lens[cur] += n;
+		bytes		+= n;
+		size		-= n;
+
+		if (sink->lens[cur] == JRY_SINKCHUNK)
+			sink->cur += 1;
+	}
+
+	return 0;
+}
+
+static int putulong(struct jy_sink *sink, unsigned long num, bool neg)
+{
+	char  buf[24];
+	char *end = buf + sizeof(buf);
+	char *ptr = end;
+
+	do {
+		*--ptr	= '0' + num % 10;
+		num    /= 10;
+	} while (num);
+
+	if (neg)
+		*--ptr = '-';
+
+	return put(sink, ptr, end - ptr);
+}
+
+static int putlong(struct jy_sink *sink, long num)
+{
+	// negate through unsigned, LONG_MIN has no positive counterpart
+	if (num < 0)
+		return putulong(sink, -(unsigned long) num, true);
+
+	return putulong(sink, num, false);
+}
+
+// JSON string of str, runs without anything to escape are copied whole
+static int putstr(struct jy_sink *sink, const char *str, size_t size)
+{
+	static const char hex[] = "0123456789abcdef";
+
+	size_t run = 0;
+
+	if (put(sink, "\"", 1))
+		return 1;
+
+	for (size_t i = 0; i < size; ++i) {
+		unsigned char c = str[i];
+
+		if (c >= 0x20 && c != '"' && c != '\\')
+			continue;
+
+		if (put(sink, str + run, i - run))
+			return 1;
+
+		char esc[6] = { '\\', c, 0 };
+		int  escsz  = 2;
+
+		switch (c) {
+		case '"':
+		case '\\':
+			break;
+		case '\n':
+			esc[1] = 'n';
+			break;
+		case '\r':
+			esc[1] = 'r';
+			break;
+		case '\t':
+			esc[1] = 't';
+			break;
+		default:
+			memcpy(esc + 1, "u00", 3);
+			esc[4] = hex[c >> 4];
+			esc[5] = hex[c & 0xf];
+			escsz  = 6;
+			break;
+		}
+
+		if (put(sink, esc, escsz))
+			return 1;
+
+		run = i + 1;
+	}
+
+	if (put(sink, str + run, size - run))
+		return 1;
+
+	return put(sink, "\"", 1);
+}
+
+#define PUT(lit) put(sink, lit, sizeof(lit) - 1)
+
+int jry_sink_ndjson(struct jy_sink	 *sink,
+		    const char		 *rule,
+		    long		  time,
+		    const union jy_value *values,
+		    const enum jy_ktype	 *types,
+		    uint32_t		  size)
+{
+	if (PUT("{"))
+		return 1;
+
+	if (rule && (PUT("\"rule\":") || putstr(sink, rule, strlen(rule))
+		     || PUT(",")))
+		return 1;
+
+	if (time >= 0 && (PUT("\"time\":") || putlong(sink, time) || PUT(",")))
+		return 1;
+
+	if (PUT("\"output\":["))
+		return 1;
+
+	for (uint32_t i = 0; i < size; ++i) {
+		union jy_value v   = values[i];
+		int	       ret = 0;
+
+		if (i && PUT(","))
+			return 1;
+
+		switch (types[i]) {
+		case JY_K_STR:
+			ret = putstr(sink, v.str->cstr, v.str->size);
+			break;
+		case JY_K_BOOL:
+			ret = v.i64 ? PUT("true") : PUT("false");
+			break;
+		case JY_K_ULONG:
+			ret = putulong(sink, v.u64, false);
+			break;
+		case JY_K_LONG:
+			ret = putlong(sink, v.i64);
+			break;
+		default:
+			ret = PUT("null");
+			break;
+		}
+
+		if (ret)
+			return 1;
+	}
+
+	return PUT("]}\n");
+}
+
+#undef PUT
+
+int jry_sink_flush(struct jy_sink *sink)
+{
+	struct iovec  iov[JRY_SINKIOV];
+	struct iovec *v	     = iov;
+	int	      iovcnt = 0;
+
+	for (uint32_t i = 0; i < JRY_SINKIOV && sink->lens[i]; ++i) {
+		iov[iovcnt].iov_base  = sink->chunks[i];
+		iov[iovcnt].iov_len   = sink->lens[i];
+		iovcnt		     += 1;
+		sink->lens[i]	      = 0;
+	}
+
+	sink->cur = 0;
+
+	while (iovcnt > 0) {
+		ssize_t n = writev(sink->fd, v, iovcnt);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+
+		if (n < 0)
+			return 1;
+
+		// a short write leaves part of the chunks behind
+		while (iovcnt > 0 && (size_t) n >= v->iov_len) {
+			n      -= v->iov_len;
+			v      += 1;
+			iovcnt -= 1;
+		}
+
+		if (iovcnt > 0) {
+			v->iov_base  = (char *) v->iov_base + n;
+			v->iov_len  -= n;
+		}
+	}
+
+	return 0;
+}
+
+void jry_sink_free(struct jy_sink *sink)
+{
+	for (uint32_t i = 0; i < JRY_SINKIOV; ++i)
+		free(sink->chunks[i]);
+}
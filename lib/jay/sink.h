@@ -0,0 +1,69 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2024. Muhammad Raznan. All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef JAYVM_SINK_H
+#define JAYVM_SINK_H
+
+#include "jary/types.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// a sink buffers up to JRY_SINKIOV chunks, written by a single writev
+#define JRY_SINKIOV   16
+#define JRY_SINKCHUNK 65536
+
+struct jy_sink {
+	// chunks are kept between flushes, allocated once needed
+	char	*chunks[JRY_SINKIOV];
+	size_t	 lens[JRY_SINKIOV];
+	// chunk being filled
+	uint32_t cur;
+	int	 fd;
+};
+
+// Append one output row as a JSON line, the rule name and the time are
+// left out when rule is NULL and time is negative. Returns non zero when
+// out of memory or a flush failed.
+int jry_sink_ndjson(struct jy_sink	 *sink,
+		    const char		 *rule,
+		    long		  time,
+		    const union jy_value *values,
+		    const enum jy_ktype	 *types,
+		    uint32_t		  size);
+
+// write every buffered byte to the sink file descriptor
+int jry_sink_flush(struct jy_sink *sink);
+
+void jry_sink_free(struct jy_sink *sink);
+
+#endif // JAYVM_SINK_H
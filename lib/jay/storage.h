@@ -34,6 +34,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef JAYVM_Q_H
 #define JAYVM_Q_H
 
+#include "exec.h"
+
 #include "jary/defs.h"
 #include "jary/memory.h"
 
@@ -43,12 +45,25 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <stdio.h>
 #include <string.h>
 
-typedef int(q_clbk)(void *, int, char **, char **);
+struct Qcol;
+
+// called per result row and once more with a NULL statement after the
+// last one, a nonzero return stops the query
+typedef int(q_clbk)(void *, struct sqlite3_stmt *, int, const struct Qcol *);
 
 struct sqlite3;
 struct jy_defs;
 struct jy_time_ofs;
 
+// maps a result column to the event member it decodes into
+struct Qcol {
+	const char     *table;
+	const char     *column;
+	struct jy_defs *event;
+	uint32_t	member;
+	enum jy_ktype	type;
+};
+
 enum QMtag {
 	QM_NONE = 0,
 	QM_BINARY,
@@ -107,9 +122,20 @@ struct QMjoin {
 };
 
 struct Qmatch {
-	int		qlen;
-	struct QMbase **qlist;
-	struct jy_defs *names;
+	int		      qlen;
+	struct QMbase	    **qlist;
+	struct jy_defs	     *names;
+	// event fields read by the rule, resolved against vals
+	const union jy_value *vals;
+	const struct jy_desc *reads;
+	int		      readsz;
+	// conditions pushed down by the compiler, NULL if none
+	const char	     *where;
+	// rows younger than window seconds live in the hot schema
+	long		      window;
+	bool		      tiered;
+	// the newest __ingest__ of the row events follows the read fields
+	bool		      ingest;
 };
 
 static inline bool exists(int			 length,
@@ -123,45 +149,71 @@ static inline bool exists(int			 length,
 	return false;
 }
 
+static inline bool inhot(int			   withinsz,
+			 const struct QMwithin **within,
+			 const char		  *table,
+			 long			   window)
+{
+	for (int i = 0; i < withinsz; ++i) {
+		const struct QMwithin *Q = within[i];
+		long ofs		 = Q->timeofs.offset * Q->timeofs.time;
+
+		if (ofs < window && strcmp(Q->table, table) == 0)
+			return true;
+	}
+
+	return false;
+}
+
 static inline int prslcq(int bufsz,
 			 char *restrict buf,
+			 bool			  tiered,
+			 long			  window,
+			 int			  colsz,
 			 int			  eventsz,
 			 int			  joinsz,
 			 int			  binsz,
 			 int			  withinsz,
 			 int			  betweensz,
-			 const struct jy_defs	**events,
+			 const struct Qcol	 *cols,
 			 const char		**evnames,
 			 const struct QMjoin	**joins,
 			 const struct QMbinary	**binary,
 			 const struct QMbetween **between,
-			 const struct QMwithin	**within)
+			 const struct QMwithin	**within,
+			 const char		 *where,
+			 bool			  ingest)
 {
 #define SIZE() bufsz ? bufsz - sz : 0
 #define PTR()  sz ? buf + sz : buf
-	int	      sz   = 0;
-	struct sc_mem bump = { .buf = NULL };
+	int sz = 0;
 
 	sz += snprintf(PTR(), SIZE(), "SELECT");
 
-	for (int i = 0; i < eventsz; ++i) {
-		const struct jy_defs *event = events[i];
-		char **keys = sc_alloc(&bump, sizeof(void *) * event->size);
+	for (int i = 0; i < colsz; ++i) {
+		const char *t = cols[i].table;
+		const char *c = cols[i].column;
 
-		if (keys == NULL)
-			goto OUT_OF_MEMORY;
+		sz += snprintf(PTR(), SIZE(), " %s.%s,", t, c);
+	}
 
-		const char *t	= evnames[i];
-		int	    len = def_keys(event, event->size, keys);
+	// max() of a single argument is the aggregate one
+	if (ingest && eventsz > 1) {
+		sz += snprintf(PTR(), SIZE(), " max(");
 
-		const char fmt[] = " %s.%s AS '%s.%s',";
+		for (int i = 0; i < eventsz; ++i) {
+			const char *sep = i + 1 < eventsz ? ", " : "),";
 
-		for (int j = 0; j < len; ++j) {
-			const char *c = keys[j];
-			sz += snprintf(PTR(), SIZE(), fmt, t, c, t, c);
+			sz += snprintf(PTR(), SIZE(), "%s.__ingest__%s",
+				       evnames[i], sep);
 		}
+	} else if (ingest) {
+		sz += snprintf(PTR(), SIZE(), " %s.__ingest__,", evnames[0]);
 	}
 
+	if (colsz == 0 && !ingest)
+		sz += snprintf(PTR(), SIZE(), " 1,");
+
 	if (buf)
 		buf[sz - 1] = ' ';
 
@@ -169,11 +221,25 @@ static inline int prslcq(int bufsz,
 
 	for (int i = 0; i < eventsz; ++i) {
 		const char *tbl = evnames[i];
+		const char *sep = i + 1 < eventsz ? "," : " WHERE";
 
-		if (i + 1 < eventsz)
-			sz += snprintf(PTR(), SIZE(), " %s,", tbl);
-		else
-			sz += snprintf(PTR(), SIZE(), " %s WHERE", tbl);
+		if (!tiered) {
+			sz += snprintf(PTR(), SIZE(), " %s%s", tbl, sep);
+			continue;
+		}
+
+		// the window never reaches the cold tier, skip the union
+		if (inhot(withinsz, within, tbl, window)) {
+			const char fmt[] = " hot.%s AS %s%s";
+
+			sz += snprintf(PTR(), SIZE(), fmt, tbl, tbl, sep);
+			continue;
+		}
+
+		const char fmt[] = " (SELECT * FROM hot.%s UNION ALL"
+				   " SELECT * FROM main.%s) AS %s%s";
+
+		sz += snprintf(PTR(), SIZE(), fmt, tbl, tbl, tbl, sep);
 	}
 
 	for (int i = 0; i < joinsz; ++i) {
@@ -243,67 +309,61 @@ static inline int prslcq(int bufsz,
 		sz += snprintf(PTR(), SIZE(), fmt, t, c, min, t, c, max);
 	}
 
+	if (where != NULL)
+		sz += snprintf(PTR(), SIZE(), " %s AND", where);
+
 	if (buf) {
 		buf[sz - 4] = ';';
 		buf[sz - 3] = '\0';
 	}
 
-	sc_free(&bump);
-
 	return sz;
 
-OUT_OF_MEMORY:
-	sc_free(&bump);
-
-	if (buf)
-		*buf = '\0';
-
-	return 0;
-
 #undef SIZE
 #undef PTR
 }
 
-static inline int q_match(struct sqlite3 *db,
-			  char		**errmsg,
-			  q_clbk	 *callback,
-			  void		 *data,
-			  struct Qmatch	  Q)
+// build the SELECT statement of Q and the map of its result columns,
+// both allocated from buf
+static inline int q_sql(struct sc_mem	   *buf,
+			struct Qmatch	    Q,
+			char		  **sql,
+			int		   *colsz,
+			const struct Qcol **cols)
 {
-	int	      ret = 0;
-	struct sc_mem buf = { .buf = NULL };
+	int ret = 0;
 
 	int		qlen  = Q.qlen;
 	struct QMbase **qs    = Q.qlist;
 	struct jy_defs *names = Q.names;
 
 	size_t		      arsz  = sizeof(void *) * qlen;
-	const struct QMjoin **joins = sc_alloc(&buf, arsz);
+	const struct QMjoin **joins = sc_alloc(buf, arsz);
 
 	if (joins == NULL)
 		goto OUT_OF_MEMORY;
 
-	const struct QMbinary **binary = sc_alloc(&buf, arsz);
+	const struct QMbinary **binary = sc_alloc(buf, arsz);
 
 	if (binary == NULL)
 		goto OUT_OF_MEMORY;
 
-	const struct QMbetween **between = sc_alloc(&buf, arsz);
+	const struct QMbetween **between = sc_alloc(buf, arsz);
 
 	if (between == NULL)
 		goto OUT_OF_MEMORY;
 
-	const struct QMwithin **within = sc_alloc(&buf, arsz);
+	const struct QMwithin **within = sc_alloc(buf, arsz);
 
 	if (within == NULL)
 		goto OUT_OF_MEMORY;
 
-	const struct jy_defs **events = sc_alloc(&buf, arsz * 2);
+	const struct jy_defs **events = sc_alloc(buf, arsz * 2);
 
 	if (events == NULL)
 		goto OUT_OF_MEMORY;
 
-	const char **eventnames = sc_alloc(&buf, arsz * 2);
+	const char **eventnames = sc_alloc(buf, arsz * 2);
 
 	if (eventnames == NULL)
 		goto OUT_OF_MEMORY;
@@ -374,27 +434,271 @@ static inline int q_match(struct sqlite3 *db,
 		}
 	}
 
-	int sz = prslcq(0, NULL, eventsz, joinsz, binsz, withinsz, betweensz,
-			events, eventnames, joins, binary, between, within);
+	struct Qcol *col = sc_alloc(buf, sizeof(*col) * (Q.readsz + 1));
 
-	if (sz == 0)
+	if (col == NULL)
 		goto OUT_OF_MEMORY;
 
-	char *sql = sc_alloc(&buf, sz);
+	int colnum = 0;
+
+	// only the fields the rule reads, events outside the query stay unset
+	for (int i = 0; i < Q.readsz; ++i) {
+		struct jy_desc	d     = Q.reads[i];
+		struct jy_defs *event = Q.vals[d.name].def;
+		int		k     = 0;
+
+		while (k < eventsz && events[k] != event)
+			k += 1;
+
+		if (k == eventsz)
+			continue;
 
-	if (sql == NULL)
+		col[colnum] = (struct Qcol) {
+			.table	= eventnames[k],
+			.column = event->keys[d.member],
+			.event	= event,
+			.member = d.member,
+			.type	= event->types[d.member],
+		};
+
+		colnum += 1;
+	}
+
+	int sz = prslcq(0, NULL, Q.tiered, Q.window, colnum, eventsz, joinsz,
+			binsz, withinsz, betweensz, col, eventnames, joins,
+			binary, between, within, Q.where, Q.ingest);
+
+	char *str = sc_alloc(buf, sz);
+
+	if (str == NULL)
 		goto OUT_OF_MEMORY;
 
-	prslcq(sz, sql, eventsz, joinsz, binsz, withinsz, betweensz, events,
-	       eventnames, joins, binary, between, within);
+	prslcq(sz, str, Q.tiered, Q.window, colnum, eventsz, joinsz, binsz,
+	       withinsz, betweensz, col, eventnames, joins, binary, between,
+	       within, Q.where, Q.ingest);
 
 	// This shouldn't happen, but just to make sure...
-	if (*sql == '\0')
+	if (*str == '\0')
+		goto OUT_OF_MEMORY;
+
+	*sql   = str;
+	*colsz = colnum;
+	*cols  = col;
+
+	goto FINISH;
+
+OUT_OF_MEMORY:
+	ret = 1;
+	goto FINISH;
+
+INV_QUERY:
+	ret = 2;
+
+FINISH:
+	return ret;
+}
+
+static inline int q_step(sqlite3_stmt *stmt, uint64_t *prof)
+{
+	if (prof == NULL)
+		return sqlite3_step(stmt);
+
+	uint64_t start = jry_monotonic();
+	int	 rc    = sqlite3_step(stmt);
+
+	prof[1] += jry_monotonic() - start;
+
+	return rc;
+}
+
+// when prof is set, it gets the nanoseconds spent preparing and then
+// stepping the query added to its first and second values
+static inline int q_match(struct sqlite3 *db,
+			  char		**errmsg,
+			  q_clbk	 *callback,
+			  void		 *data,
+			  struct Qmatch	  Q,
+			  uint64_t	 *prof)
+{
+	int		   ret	 = 0;
+	struct sc_mem	   buf	 = { .buf = NULL };
+	char		  *sql	 = NULL;
+	sqlite3_stmt	  *stmt	 = NULL;
+	const struct Qcol *cols	 = NULL;
+	int		   colsz = 0;
+	uint64_t	   start = prof ? jry_monotonic() : 0;
+
+	ret = q_sql(&buf, Q, &sql, &colsz, &cols);
+
+	if (ret != 0)
+		goto FINISH;
+
+	if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+		goto INV_QUERY;
+
+	if (prof != NULL)
+		prof[0] += jry_monotonic() - start;
+
+	for (int rc; (rc = q_step(stmt, prof)) != SQLITE_DONE;) {
+		if (rc != SQLITE_ROW)
+			goto INV_QUERY;
+
+		if (callback(data, stmt, colsz, cols))
+			goto INV_QUERY;
+	}
+
+	if (callback(data, NULL, colsz, cols))
+		goto INV_QUERY;
+
+	goto FINISH;
+
+INV_QUERY:
+	if (errmsg != NULL)
+		*errmsg = sqlite3_mprintf("%s", sqlite3_errmsg(db));
+
+	ret = 2;
+
+FINISH:
+	sqlite3_finalize(stmt);
+	sc_free(&buf);
+	return ret;
+}
+
+static inline bool fullscan(const char *detail)
+{
+	return strncmp(detail, "SCAN ", 5) == 0 && detail[5] != '('
+	    && strstr(detail, " USING ") == NULL;
+}
+
+static inline int prplan(int bufsz,
+			 char *restrict buf,
+			 const char	    *sql,
+			 int		     rowsz,
+			 const int	    *parents,
+			 const int	    *ids,
+			 const char *const *details)
+{
+#define SIZE() bufsz ? bufsz - sz : 0
+#define PTR()  sz ? buf + sz : buf
+	int sz = 0;
+	int depths[rowsz + 1];
+
+	sz += snprintf(PTR(), SIZE(), "SQL\n  %s\nQUERY PLAN\n", sql);
+
+	for (int i = 0; i < rowsz; ++i) {
+		const char *detail = details[i];
+		const char *flag   = "";
+
+		depths[i] = 1;
+
+		for (int j = 0; j < i; ++j)
+			if (ids[j] == parents[i])
+				depths[i] = depths[j] + 1;
+
+		if (strstr(detail, "USE TEMP B-TREE"))
+			flag = "  <-- temp b-tree";
+
+		if (fullscan(detail)) {
+			flag = "  <-- full scan";
+
+			// a nested loop over another unindexed scan
+			for (int j = 0; j < i; ++j)
+				if (parents[j] == parents[i]
+				    && fullscan(details[j]))
+					flag = "  <-- cross join without index";
+		}
+
+		sz += snprintf(PTR(), SIZE(), "%*c%s%s\n", depths[i] * 2, ' ',
+			       detail, flag);
+	}
+
+	// include '\0'
+	sz += 1;
+
+	return sz;
+#undef SIZE
+#undef PTR
+}
+
+// EXPLAIN QUERY PLAN of Q, text is allocated with malloc
+static inline int q_plan(struct sqlite3 *db, struct Qmatch Q, char **text)
+{
+	int	      ret     = 0;
+	struct sc_mem buf     = { .buf = NULL };
+	char	     *sql     = NULL;
+	char	     *explain = NULL;
+	sqlite3_stmt *stmt    = NULL;
+
+	int	     rowsz   = 0;
+	int	    *ids     = NULL;
+	int	    *parents = NULL;
+	const char **details = NULL;
+
+	int		   colsz;
+	const struct Qcol *cols;
+
+	ret = q_sql(&buf, Q, &sql, &colsz, &cols);
+
+	if (ret != 0)
+		goto FINISH;
+
+	sc_strfmt(&buf, &explain, "EXPLAIN QUERY PLAN %s", sql);
+
+	if (explain == NULL)
 		goto OUT_OF_MEMORY;
 
-	if (sqlite3_exec(db, sql, callback, data, errmsg) != SQLITE_OK)
+	if (sqlite3_prepare_v2(db, explain, -1, &stmt, NULL) != SQLITE_OK)
 		goto INV_QUERY;
 
+	if (sc_reap(&buf, &ids, (free_t) ifree))
+		goto OUT_OF_MEMORY;
+
+	if (sc_reap(&buf, &parents, (free_t) ifree))
+		goto OUT_OF_MEMORY;
+
+	if (sc_reap(&buf, &details, (free_t) ifree))
+		goto OUT_OF_MEMORY;
+
+	// columns are: id, parent, notused, detail
+	for (int rc; (rc = sqlite3_step(stmt)) != SQLITE_DONE;) {
+		if (rc != SQLITE_ROW)
+			goto INV_QUERY;
+
+		const char *column = (const char *) sqlite3_column_text(stmt, 3);
+		char	   *detail = NULL;
+
+		sc_strfmt(&buf, &detail, "%s", column ? column : "");
+
+		if (detail == NULL)
+			goto OUT_OF_MEMORY;
+
+		jry_mem_push(ids, rowsz, sqlite3_column_int(stmt, 0));
+
+		if (ids == NULL)
+			goto OUT_OF_MEMORY;
+
+		jry_mem_push(parents, rowsz, sqlite3_column_int(stmt, 1));
+
+		if (parents == NULL)
+			goto OUT_OF_MEMORY;
+
+		jry_mem_push(details, rowsz, detail);
+
+		if (details == NULL)
+			goto OUT_OF_MEMORY;
+
+		rowsz += 1;
+	}
+
+	int   sz  = prplan(0, NULL, sql, rowsz, parents, ids, details);
+	char *str = malloc(sz);
+
+	if (str == NULL)
+		goto OUT_OF_MEMORY;
+
+	prplan(sz, str, sql, rowsz, parents, ids, details);
+	*text = str;
+
 	goto FINISH;
 
 OUT_OF_MEMORY:
@@ -405,8 +709,10 @@ INV_QUERY:
 	ret = 2;
 
 FINISH:
+	sqlite3_finalize(stmt);
 	sc_free(&buf);
 	return ret;
 }
 
+
 #endif // JAYVM_Q_H
@@ -0,0 +1,146 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2024. Muhammad Raznan. All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "suppress.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define LOADMAX (JRY_SUPPRESSSLOTS / 4 * 3)
+
+static inline uint64_t mix(uint64_t hash, const void *bytes, size_t size)
+{
+	const unsigned char *ptr = bytes;
+
+	for (size_t i = 0; i < size; ++i) {
+		hash ^= ptr[i];
+		hash *= 1099511628211u;
+	}
+
+	return hash;
+}
+
+static uint64_t rowhash(const union jy_value *values,
+			const enum jy_ktype  *types,
+			uint32_t	      size)
+{
+	uint64_t hash = 14695981039346656037u;
+
+	for (uint32_t i = 0; i < size; ++i) {
+		union jy_value v = values[i];
+
+		// a separator keeps ("ab", "c") apart from ("a", "bc")
+		hash = mix(hash, &types[i], sizeof(types[i]));
+
+		if (types[i] == JY_K_STR)
+			hash = mix(hash, v.str->cstr, v.str->size + 1);
+		else
+			hash = mix(hash, &v.i64, sizeof(v.i64));
+	}
+
+	// 0 marks an empty slot
+	return hash ? hash : 1;
+}
+
+int jry_suppress_new(struct jy_suppress **supp, uint32_t window)
+{
+	struct jy_suppress *S = calloc(1, sizeof(*S));
+
+	if (S == NULL)
+		return 1;
+
+	S->span = window / (JRY_SUPPRESSGENS - 1);
+
+	if (S->span == 0)
+		S->span = 1;
+
+	*supp = S;
+
+	return 0;
+}
+
+static inline void rotate(struct jy_suppress *supp)
+{
+	supp->cur = (supp->cur + 1) % JRY_SUPPRESSGENS;
+
+	memset(supp->slots[supp->cur], 0, sizeof(supp->slots[supp->cur]));
+	supp->counts[supp->cur] = 0;
+}
+
+static inline bool seen(const uint64_t *slots, uint64_t hash)
+{
+	for (uint32_t i = hash;; ++i) {
+		uint64_t slot = slots[i % JRY_SUPPRESSSLOTS];
+
+		if (slot == hash)
+			return true;
+
+		if (slot == 0)
+			return false;
+	}
+}
+
+bool jry_suppressed(struct jy_suppress	 *supp,
+		    long		  now,
+		    const union jy_value *values,
+		    const enum jy_ktype	 *types,
+		    uint32_t		  size)
+{
+	long epoch = now / supp->span;
+	long gone  = epoch - supp->epoch;
+
+	// every span gone by clears a generation, all of them at most
+	for (long i = 0; i < gone && i < JRY_SUPPRESSGENS; ++i)
+		rotate(supp);
+
+	if (gone > 0)
+		supp->epoch = epoch;
+
+	uint64_t hash = rowhash(values, types, size);
+
+	for (uint32_t g = 0; g < JRY_SUPPRESSGENS; ++g)
+		if (supp->counts[g] && seen(supp->slots[g], hash))
+			return true;
+
+	if (supp->counts[supp->cur] >= LOADMAX)
+		rotate(supp);
+
+	uint64_t *slots = supp->slots[supp->cur];
+	uint32_t  i	= hash % JRY_SUPPRESSSLOTS;
+
+	while (slots[i] != 0)
+		i = (i + 1) % JRY_SUPPRESSSLOTS;
+
+	slots[i]		 = hash;
+	supp->counts[supp->cur] += 1;
+
+	return false;
+}
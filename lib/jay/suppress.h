@@ -0,0 +1,67 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2024. Muhammad Raznan. All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef JAYVM_SUPPRESS_H
+#define JAYVM_SUPPRESS_H
+
+#include "jary/types.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// A suppression window is split into JRY_SUPPRESSGENS - 1 spans, every
+// span records the output hashes seen during it in a generation of
+// JRY_SUPPRESSSLOTS slots. The oldest generation is cleared once a span
+// ends, or earlier when the current one fills up, so memory is bounded
+// and a hash is remembered for at least the window unless under pressure.
+#define JRY_SUPPRESSGENS  4
+#define JRY_SUPPRESSSLOTS 2048
+
+struct jy_suppress {
+	uint64_t slots[JRY_SUPPRESSGENS][JRY_SUPPRESSSLOTS];
+	uint32_t counts[JRY_SUPPRESSGENS];
+	// generation taking new hashes, and the span it belongs to
+	uint32_t cur;
+	long	 epoch;
+	long	 span;
+};
+
+int jry_suppress_new(struct jy_suppress **supp, uint32_t window);
+
+// true when an equal row was seen within the window, the row is
+// recorded otherwise
+bool jry_suppressed(struct jy_suppress	 *supp,
+		    long		  now,
+		    const union jy_value *values,
+		    const enum jy_ktype	 *types,
+		    uint32_t		  size);
+
+#endif // JAYVM_SUPPRESS_H
@@ -73,6 +73,7 @@ enum jy_tkn {
 	TKN_MATCH,
 	TKN_CONDITION,
 	TKN_FIELD,
+	TKN_SUPPRESS,
 	// < SECTIONS
 
 	TKN_WITHIN,
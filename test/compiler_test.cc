@@ -38,6 +38,7 @@ extern "C" {
 #include "parser.h"
 #include "token.h"
 
+#include "jary/defs.h"
 #include "jary/memory.h"
 }
 
@@ -89,12 +90,14 @@ TEST(CompilerTest, Basic)
 
 	// clang-format off
 	uint8_t codes[] = {
+                // bye never passes its condition, no query is left
+                JY_OP_END,
                 //
-                JY_OP_PUSH8, 12,
-                JY_OP_PUSH8, 9,
+                JY_OP_PUSH8, 10,
+                JY_OP_PUSH8, 7,
                 JY_OP_EQUAL,
                 JY_OP_PUSH8, 2,
-                JY_OP_PUSH8, 10,
+                JY_OP_PUSH8, 11,
                 JY_OP_QUERY,
                 JY_OP_END,
         };
@@ -102,6 +105,9 @@ TEST(CompilerTest, Basic)
 
 	ASSERT_EQ(errs.size, 0);
 	ASSERT_EQ(ctx.codesz, sizeof(codes));
+	ASSERT_EQ(ctx.deadsz, 1);
+	ASSERT_STREQ(ctx.names->keys[ctx.deadnids[0]], "bye");
+	ASSERT_EQ(ctx.fcodes[0], JY_OP_END);
 
 	for (size_t i = 0; i < sizeof(codes); ++i)
 		ASSERT_EQ(ctx.codes[i], codes[i]) << "codes[" << i << "]";
@@ -108,6 +108,9 @@ TEST(ExecTest, MarkModule)
 
 	ASSERT_EQ(errs.size, 0);
 
+	// mark.mark returns nothing, the call never pushes
+	ASSERT_EQ(jay.fcodes[5], JY_OP_CALLV);
+
 	{
 		uint32_t id;
 
@@ -413,3 +416,463 @@ TEST(ExecTest, ExactEqual)
 	sc_free(&alloc);
 	sb_free(&bump);
 }
+
+TEST(ExecTest, TypedRow)
+{
+	struct jy_asts	asts  = { .tkns = NULL };
+	struct jy_tkns	tkns  = { .lexemes = NULL };
+	struct tkn_errs errs  = { .from = NULL };
+	struct jy_jay	jay   = { .codes = NULL };
+	struct sc_mem	alloc = { .buf = NULL };
+	struct sb_mem	bump  = { .buf = NULL };
+	struct sqlite3 *db    = NULL;
+	char	       *src   = NULL;
+	size_t		srcsz = read_file(TYPED_ROW_JARY_PATH, &src);
+
+	sc_reap(&alloc, src, free);
+
+	const char mdir[] = "../modules/";
+
+	jry_parse(&alloc, &asts, &tkns, &errs, src, srcsz);
+
+	ASSERT_EQ(errs.size, 0);
+
+	jry_compile(&alloc, &jay, &errs, mdir, &asts, &tkns);
+
+	ASSERT_EQ(errs.size, 0);
+
+	// between takes a descriptor and two bounds
+	ASSERT_EQ(jay.rulestack[0], 3);
+	ASSERT_EQ(jay.stackmax, 3);
+
+	int flag = SQLITE_OPEN_MEMORY | SQLITE_OPEN_PRIVATECACHE
+		 | SQLITE_OPEN_READWRITE;
+
+	int err = sqlite3_open_v2("test.db", &db, flag, NULL);
+
+	ASSERT_EQ(err, SQLITE_OK) << "msg: " << sqlite3_errmsg(db);
+
+	char *sql = "CREATE TABLE data (name TEXT, age INTEGER);"
+		    "INSERT INTO data (name, age) VALUES ('root', 18),"
+		    "('admin', 25), ('guest', 40);";
+	char *msg = NULL;
+	err	  = sqlite3_exec(db, sql, NULL, NULL, &msg);
+
+	ASSERT_EQ(err, SQLITE_OK) << "msg: " << msg;
+
+	struct jy_state state = { .lifetime = &alloc, .outm = &bump };
+
+	ASSERT_EQ(jry_exec(db, &jay, jay.codes, &state), 0);
+
+	// strings of earlier rows must outlive the row they came from
+	ASSERT_EQ(state.outsz, 4);
+	ASSERT_STREQ(state.out[0].str->cstr, "root");
+	ASSERT_EQ(state.out[1].i64, 18);
+	ASSERT_STREQ(state.out[2].str->cstr, "admin");
+	ASSERT_EQ(state.out[3].i64, 25);
+
+	sqlite3_close_v2(db);
+	sc_free(&alloc);
+	sb_free(&bump);
+}
+
+TEST(ExecTest, Intern)
+{
+	struct jy_asts	 asts  = { .tkns = NULL };
+	struct jy_tkns	 tkns  = { .lexemes = NULL };
+	struct tkn_errs	 errs  = { .from = NULL };
+	struct jy_jay	 jay   = { .codes = NULL };
+	struct sc_mem	 alloc = { .buf = NULL };
+	struct sb_mem	 bump  = { .buf = NULL };
+	struct jy_intern strs  = { .arena = NULL };
+	struct sqlite3	*db    = NULL;
+	char		*src   = NULL;
+	size_t		 srcsz = read_file(EXACT_EQUAL_JARY_PATH, &src);
+
+	sc_reap(&alloc, src, free);
+
+	const char mdir[] = "../modules/";
+
+	jry_parse(&alloc, &asts, &tkns, &errs, src, srcsz);
+
+	ASSERT_EQ(errs.size, 0);
+
+	jry_compile(&alloc, &jay, &errs, mdir, &asts, &tkns);
+
+	ASSERT_EQ(errs.size, 0);
+
+	jry_intern_pool(&strs, &jay);
+
+	ASSERT_TRUE(jay.interned);
+
+	// a row string equal to a constant is the constant itself
+	struct jy_str *root = jry_intern(&strs, "root", 4);
+
+	ASSERT_NE(root, nullptr);
+	ASSERT_TRUE(jry_interned(&strs, root));
+
+	bool pooled = false;
+
+	for (uint32_t i = 0; i < jay.valsz; ++i)
+		pooled |= jay.types[i] == JY_K_STR && jay.vals[i].str == root;
+
+	ASSERT_TRUE(pooled);
+
+	struct jy_str *guest = jry_intern(&strs, "guest", 5);
+
+	ASSERT_EQ(jry_intern(&strs, "guest", 5), guest);
+	ASSERT_NE(guest, root);
+
+	char big[JRY_INTERNLEN + 1];
+
+	memset(big, 'a', sizeof(big));
+
+	ASSERT_EQ(jry_intern(&strs, big, sizeof(big)), nullptr);
+
+	// the row strings go, the constants stay where they are
+	jry_intern_reset(&strs, false);
+
+	ASSERT_EQ(jry_intern(&strs, "root", 4), root);
+
+	int flag = SQLITE_OPEN_MEMORY | SQLITE_OPEN_PRIVATECACHE
+		 | SQLITE_OPEN_READWRITE;
+
+	int err = sqlite3_open_v2("test.db", &db, flag, NULL);
+
+	ASSERT_EQ(err, SQLITE_OK) << "msg: " << sqlite3_errmsg(db);
+
+	char *sql = "CREATE TABLE data (name TEXT, age INTEGER);"
+		    "INSERT INTO data (name, age) VALUES ('root', 18);";
+	char *msg = NULL;
+	err	  = sqlite3_exec(db, sql, NULL, NULL, &msg);
+
+	ASSERT_EQ(err, SQLITE_OK) << "msg: " << msg;
+
+	struct jy_state state = {
+		.lifetime = &alloc,
+		.outm	  = &bump,
+		.strs	  = &strs,
+	};
+
+	ASSERT_EQ(jry_exec(db, &jay, jay.codes, &state), 0);
+
+	ASSERT_EQ(state.outsz, 1);
+	ASSERT_EQ(state.out[0].i64, 42);
+
+	sqlite3_close_v2(db);
+	sc_free(&alloc);
+	sb_free(&bump);
+	jry_intern_free(&strs);
+}
+
+TEST(ExecTest, Pushdown)
+{
+	struct jy_asts	asts  = { .tkns = NULL };
+	struct jy_tkns	tkns  = { .lexemes = NULL };
+	struct tkn_errs errs  = { .from = NULL };
+	struct jy_jay	jay   = { .codes = NULL };
+	struct sc_mem	alloc = { .buf = NULL };
+	struct sb_mem	bump  = { .buf = NULL };
+	struct sqlite3 *db    = NULL;
+	char	       *src   = NULL;
+	size_t		srcsz = read_file(PUSHDOWN_JARY_PATH, &src);
+
+	sc_reap(&alloc, src, free);
+
+	const char mdir[] = "../modules/";
+
+	jry_parse(&alloc, &asts, &tkns, &errs, src, srcsz);
+
+	ASSERT_EQ(errs.size, 0);
+
+	jry_compile(&alloc, &jay, &errs, mdir, &asts, &tkns);
+
+	ASSERT_EQ(errs.size, 0);
+
+	// the call stays in the VM, the field comparisons move to SQL with
+	// the columns bare, NULL is spelled out where it reads differently
+	ASSERT_STREQ(jay.rulewhere[0],
+		     "((data.age > 18) AND NOT (data.name = 'o''neil'"
+		     " AND data.name IS NOT NULL))"
+		     " AND (data.age < 60 OR data.age IS NULL)");
+
+	int flag = SQLITE_OPEN_MEMORY | SQLITE_OPEN_PRIVATECACHE
+		 | SQLITE_OPEN_READWRITE;
+
+	int err = sqlite3_open_v2("test.db", &db, flag, NULL);
+
+	ASSERT_EQ(err, SQLITE_OK) << "msg: " << sqlite3_errmsg(db);
+
+	char *sql = "CREATE TABLE data (name TEXT, age INTEGER);"
+		    "INSERT INTO data (name, age) VALUES ('root', 18),"
+		    "('o''neil', 25), ('admin', 40);"
+		    "INSERT INTO data (age) VALUES (30);";
+	char *msg = NULL;
+	err	  = sqlite3_exec(db, sql, NULL, NULL, &msg);
+
+	ASSERT_EQ(err, SQLITE_OK) << "msg: " << msg;
+
+	struct jy_state state = { .lifetime = &alloc, .outm = &bump };
+
+	ASSERT_EQ(jry_exec(db, &jay, jay.codes, &state), 0);
+
+	// the unset name reads as "" like it does in the VM
+	ASSERT_EQ(state.outsz, 2);
+	ASSERT_STREQ(state.out[0].str->cstr, "admin");
+	ASSERT_STREQ(state.out[1].str->cstr, "");
+
+	sqlite3_close_v2(db);
+	sc_free(&alloc);
+	sb_free(&bump);
+}
+
+TEST(ExecTest, Fused)
+{
+	struct jy_asts	asts  = { .tkns = NULL };
+	struct jy_tkns	tkns  = { .lexemes = NULL };
+	struct tkn_errs errs  = { .from = NULL };
+	struct jy_jay	jay   = { .codes = NULL };
+	struct sc_mem	alloc = { .buf = NULL };
+	struct sb_mem	bump  = { .buf = NULL };
+	struct sqlite3 *db    = NULL;
+	char	       *src   = NULL;
+	size_t		srcsz = read_file(FUSED_JARY_PATH, &src);
+
+	sc_reap(&alloc, src, free);
+
+	const char mdir[] = "../modules/";
+
+	jry_parse(&alloc, &asts, &tkns, &errs, src, srcsz);
+
+	ASSERT_EQ(errs.size, 0);
+
+	jry_compile(&alloc, &jay, &errs, mdir, &asts, &tkns);
+
+	ASSERT_EQ(errs.size, 0);
+
+	// both field comparisons fuse, the jumps between them still land
+	const uint8_t *fcodes = jay.fcodes + jay.rulefofs[0];
+
+	ASSERT_EQ(fcodes[0], JY_OP_GT_FK);
+	ASSERT_EQ(fcodes[5], JY_OP_JMPF);
+	ASSERT_EQ(fcodes[16], JY_OP_CMPSTR_FK);
+
+	// mark.count("never") reads no row, the prologue calls it once
+	const uint8_t *pcodes = jay.pcodes + jay.rulepofs[0];
+
+	ASSERT_EQ(jay.rulereg[0], 1);
+	ASSERT_EQ(fcodes[8], JY_OP_GETR);
+	ASSERT_EQ(pcodes[5], JY_OP_CALL);
+	ASSERT_EQ(pcodes[7], JY_OP_SETR);
+
+	// an equality on a bool field fuses and still verifies
+	ASSERT_EQ(jay.fcodes[jay.rulefofs[1]], JY_OP_CMP_FK);
+
+	int flag = SQLITE_OPEN_MEMORY | SQLITE_OPEN_PRIVATECACHE
+		 | SQLITE_OPEN_READWRITE;
+
+	int err = sqlite3_open_v2("test.db", &db, flag, NULL);
+
+	ASSERT_EQ(err, SQLITE_OK) << "msg: " << sqlite3_errmsg(db);
+
+	char *sql = "CREATE TABLE data (name TEXT, age INTEGER, admin INTEGER);"
+		    "INSERT INTO data (name, age, admin) VALUES"
+		    "('root', 18, 0), ('bob', 15, 0), ('admin', 25, 1),"
+		    "('carl', 40, 0);";
+	char *msg = NULL;
+	err	  = sqlite3_exec(db, sql, NULL, NULL, &msg);
+
+	ASSERT_EQ(err, SQLITE_OK) << "msg: " << msg;
+
+	struct jy_state state = { .lifetime = &alloc, .outm = &bump };
+
+	ASSERT_EQ(jry_exec(db, &jay, jay.codes, &state), 0);
+
+	ASSERT_EQ(state.outsz, 2);
+	ASSERT_STREQ(state.out[0].str->cstr, "root");
+	ASSERT_STREQ(state.out[1].str->cstr, "admin");
+
+	// only admin has the bool set
+	ASSERT_EQ(jry_exec(db, &jay, jay.codes + jay.rulecofs[1], &state), 0);
+
+	ASSERT_EQ(state.outsz, 3);
+	ASSERT_STREQ(state.out[2].str->cstr, "admin");
+
+	sqlite3_close_v2(db);
+	sc_free(&alloc);
+	sb_free(&bump);
+}
+
+TEST(ExecTest, Folded)
+{
+	struct jy_asts	asts  = { .tkns = NULL };
+	struct jy_tkns	tkns  = { .lexemes = NULL };
+	struct tkn_errs errs  = { .from = NULL };
+	struct jy_jay	jay   = { .codes = NULL };
+	struct sc_mem	alloc = { .buf = NULL };
+	struct sb_mem	bump  = { .buf = NULL };
+	struct sa_mem	arena = { .head = NULL };
+	struct sqlite3 *db    = NULL;
+	char	       *src   = NULL;
+	size_t		srcsz = read_file(FOLDED_JARY_PATH, &src);
+
+	sc_reap(&alloc, src, free);
+
+	const char mdir[] = "../modules/";
+
+	jry_parse(&alloc, &asts, &tkns, &errs, src, srcsz);
+
+	ASSERT_EQ(errs.size, 0);
+
+	jry_compile(&alloc, &jay, &errs, mdir, &asts, &tkns);
+
+	ASSERT_EQ(errs.size, 0);
+
+	// 60 * 60 / 180 is a constant, the literal conditions are gone
+	const uint8_t *fcodes = jay.fcodes + jay.rulefofs[0];
+
+	ASSERT_EQ(fcodes[0], JY_OP_GT_FK);
+	ASSERT_EQ(jay.vals[fcodes[3] | fcodes[4] << 8].i64, 20);
+	ASSERT_EQ(fcodes[5], JY_OP_JMPF);
+
+	// the third output is read back from the first one
+	const uint8_t *dup = (const uint8_t *) memchr(fcodes, JY_OP_DUP, 64);
+
+	ASSERT_NE(dup, nullptr);
+	ASSERT_EQ(dup[1], 0);
+	ASSERT_EQ(jay.sharesz, 1);
+
+	// a chain is one concatenation, "@" .. "host" one constant
+	ASSERT_EQ(fcodes[13], JY_OP_CONCATN);
+	ASSERT_EQ(fcodes[14], 2);
+	ASSERT_STREQ(jay.vals[fcodes[12]].str->cstr, "@host");
+	ASSERT_EQ(fcodes[22], JY_OP_CONCATN);
+	ASSERT_EQ(fcodes[23], 3);
+
+	// never has no query and no code left
+	ASSERT_EQ(jay.deadsz, 1);
+	ASSERT_STREQ(jay.names->keys[jay.deadnids[0]], "never");
+	ASSERT_EQ(jay.codes[jay.rulecofs[1]], JY_OP_END);
+	ASSERT_EQ(jay.fcodes[jay.rulefofs[1]], JY_OP_END);
+
+	int flag = SQLITE_OPEN_MEMORY | SQLITE_OPEN_PRIVATECACHE
+		 | SQLITE_OPEN_READWRITE;
+
+	int err = sqlite3_open_v2("test.db", &db, flag, NULL);
+
+	ASSERT_EQ(err, SQLITE_OK) << "msg: " << sqlite3_errmsg(db);
+
+	char *sql = "CREATE TABLE data (name TEXT, age INTEGER);"
+		    "INSERT INTO data (name, age) VALUES ('root', 18),"
+		    "('bob', 15), ('admin', 25);";
+	char *msg = NULL;
+	err	  = sqlite3_exec(db, sql, NULL, NULL, &msg);
+
+	ASSERT_EQ(err, SQLITE_OK) << "msg: " << msg;
+
+	struct jy_state state = {
+		.lifetime = &alloc,
+		.outm	  = &bump,
+		.arena	  = &arena,
+	};
+
+	ASSERT_EQ(jry_exec(db, &jay, jay.codes + jay.rulecofs[0], &state), 0);
+
+	ASSERT_EQ(state.outsz, 3);
+	ASSERT_STREQ(state.out[0].str->cstr, "admin@host");
+	ASSERT_STREQ(state.out[1].str->cstr, "user admin@host");
+	ASSERT_STREQ(state.out[2].str->cstr, "admin@host");
+
+	ASSERT_EQ(jry_exec(db, &jay, jay.codes + jay.rulecofs[1], &state), 0);
+	ASSERT_EQ(state.outsz, 3);
+
+	sqlite3_close_v2(db);
+	sc_free(&alloc);
+	sb_free(&bump);
+	sa_free(&arena);
+}
+
+// stops the query at the first streamed row
+static int stop_stream(void *data, const union jy_value *values, uint32_t size)
+{
+	(void) data;
+	(void) values;
+	(void) size;
+
+	return 1;
+}
+
+TEST(ExecTest, Batch)
+{
+	struct jy_asts	asts  = { .tkns = NULL };
+	struct jy_tkns	tkns  = { .lexemes = NULL };
+	struct tkn_errs errs  = { .from = NULL };
+	struct jy_jay	jay   = { .codes = NULL };
+	struct sc_mem	alloc = { .buf = NULL };
+	struct sb_mem	bump  = { .buf = NULL };
+	struct sqlite3 *db    = NULL;
+	char	       *src   = NULL;
+	size_t		srcsz = read_file(BATCH_JARY_PATH, &src);
+
+	sc_reap(&alloc, src, free);
+
+	const char mdir[] = "../modules/";
+
+	jry_parse(&alloc, &asts, &tkns, &errs, src, srcsz);
+
+	ASSERT_EQ(errs.size, 0);
+
+	jry_compile(&alloc, &jay, &errs, mdir, &asts, &tkns);
+
+	ASSERT_EQ(errs.size, 0);
+
+	// the arithmetic runs over the batch, the call row by row
+	ASSERT_GT(jay.rulebatch[0], 0);
+
+	int flag = SQLITE_OPEN_MEMORY | SQLITE_OPEN_PRIVATECACHE
+		 | SQLITE_OPEN_READWRITE;
+
+	int err = sqlite3_open_v2("test.db", &db, flag, NULL);
+
+	ASSERT_EQ(err, SQLITE_OK) << "msg: " << sqlite3_errmsg(db);
+
+	// spans a few batches and ends with a partial one
+	char *sql = "CREATE TABLE data (name TEXT, age INTEGER);"
+		    "WITH RECURSIVE n(x) AS (SELECT 1 UNION ALL "
+		    "SELECT x + 1 FROM n WHERE x < 3000) "
+		    "INSERT INTO data SELECT 'n' || x, x FROM n;";
+	char *msg = NULL;
+	err	  = sqlite3_exec(db, sql, NULL, NULL, &msg);
+
+	ASSERT_EQ(err, SQLITE_OK) << "msg: " << msg;
+
+	struct jy_state state = { .lifetime = &alloc, .outm = &bump };
+
+	ASSERT_EQ(jry_exec(db, &jay, jay.codes, &state), 0);
+
+	ASSERT_EQ(state.outsz, 2 * 2950);
+	ASSERT_STREQ(state.out[0].str->cstr, "n51");
+	ASSERT_EQ(state.out[1].i64, 51);
+	ASSERT_STREQ(state.out[2 * 1000].str->cstr, "n1051");
+	ASSERT_EQ(state.out[2 * 1000 + 1].i64, 1051);
+	ASSERT_STREQ(state.out[2 * 2949].str->cstr, "n3000");
+	ASSERT_EQ(state.out[2 * 2949 + 1].i64, 3000);
+
+	// the 7 filter instructions run for every row, the rest for matches
+	ASSERT_GE(state.ops, 3000 * 7 + 2950 * 10);
+
+	// a stream sees the first match before the next row is read
+	struct jy_state stream = {
+		.lifetime   = &alloc,
+		.outm	    = &bump,
+		.stream	    = stop_stream,
+		.streamonly = true,
+	};
+
+	ASSERT_EQ(jry_exec(db, &jay, jay.codes, &stream), 2);
+	ASSERT_EQ(stream.rows, 51);
+
+	sqlite3_close_v2(db);
+	sc_free(&alloc);
+	sb_free(&bump);
+}
@@ -30,6 +30,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include <gtest/gtest.h>
+#include <string>
+#include <unistd.h>
 
 extern "C" {
 #include "jary/jary.h"
@@ -90,3 +92,782 @@ TEST(JaryModuleTest, Simple)
 
 	ASSERT_EQ(jary_close(J), JARY_OK);
 }
+
+static int count_callback(void *data, const struct jyOutput *output)
+{
+	unsigned int length = 0;
+
+	jary_output_len(output, &length);
+	*(unsigned int *) data += length;
+
+	return JARY_OK;
+}
+
+// remove the database at path and the files SQLite keeps next to it
+static void remove_db(const char *path)
+{
+	std::string name = path;
+
+	remove(name.c_str());
+	remove((name + "-wal").c_str());
+	remove((name + "-shm").c_str());
+}
+
+TEST(JaryModuleTest, Storage)
+{
+	const char   path[] = "jary_storage_test.db";
+	struct jary *J;
+	unsigned int ev;
+	unsigned int count = 0;
+	char	    *text  = NULL;
+
+	// left over by an aborted run it would hold the events twice
+	remove_db(path);
+
+	ASSERT_EQ(jary_open(&J), JARY_OK);
+
+	// a zero window moves every event to disk on each execute
+	ASSERT_EQ(jary_storage(J, path, 0), JARY_OK);
+	ASSERT_EQ(jary_compile_file(J, STORAGE_JARY_PATH, NULL), JARY_OK);
+	ASSERT_EQ(jary_storage(J, path, 0), JARY_ERROR);
+
+	ASSERT_EQ(jary_rule_clbk(J, "seen_root", count_callback, &count),
+		  JARY_OK);
+
+	for (int i = 0; i < 3; ++i) {
+		ASSERT_EQ(jary_event(J, "user", &ev), JARY_OK);
+		ASSERT_EQ(jary_field_str(J, ev, "name", "root"), JARY_OK);
+	}
+
+	ASSERT_EQ(jary_event(J, "user", &ev), JARY_OK);
+	ASSERT_EQ(jary_field_str(J, ev, "name", "guest"), JARY_OK);
+
+	ASSERT_EQ(jary_execute(J), JARY_OK);
+	ASSERT_EQ(count, 3);
+
+	// the rows now live in the disk tier, the union must still see them
+	count = 0;
+	ASSERT_EQ(jary_execute(J), JARY_OK);
+	ASSERT_EQ(count, 3);
+
+	ASSERT_EQ(jary_rule_plan(J, "seen_root", &text), JARY_OK);
+	ASSERT_NE(strstr(text, "UNION ALL"), nullptr);
+
+	jary_free(text);
+
+	ASSERT_EQ(jary_close(J), JARY_OK);
+
+	remove_db(path);
+
+	// within 1h never reaches past a 2h window, only hot is read
+	ASSERT_EQ(jary_open(&J), JARY_OK);
+	ASSERT_EQ(jary_storage(J, path, 7200), JARY_OK);
+	ASSERT_EQ(jary_compile_file(J, STORAGE_JARY_PATH, NULL), JARY_OK);
+
+	ASSERT_EQ(jary_rule_plan(J, "seen_root", &text), JARY_OK);
+	ASSERT_NE(strstr(text, "FROM hot.user AS user"), nullptr);
+	ASSERT_EQ(strstr(text, "UNION ALL"), nullptr);
+
+	jary_free(text);
+
+	ASSERT_EQ(jary_close(J), JARY_OK);
+
+	remove_db(path);
+}
+
+static int row_callback(void *data, const struct jyOutput *output)
+{
+	unsigned int length = 0;
+	const char  *name   = NULL;
+
+	jary_output_len(output, &length);
+
+	if (length != 1 || jary_output_str(output, 0, &name) != JARY_OK)
+		return JARY_INT_CRASH;
+
+	if (strcmp(name, "root") != 0)
+		return JARY_INT_CRASH;
+
+	*(unsigned int *) data += 1;
+
+	return JARY_OK;
+}
+
+static int final_callback(void *data, const struct jyOutput *output)
+{
+	unsigned int length = 0;
+
+	jary_output_len(output, &length);
+
+	if (length == 0)
+		return JARY_INT_CRASH; // crash the runtime
+
+	*(unsigned int *) data += 1;
+
+	return JARY_INT_FINAL;
+}
+
+TEST(JaryModuleTest, Stream)
+{
+	struct jary *J;
+	unsigned int ev;
+	unsigned int rows  = 0;
+	unsigned int once  = 0;
+	unsigned int count = 0;
+
+	ASSERT_EQ(jary_open(&J), JARY_OK);
+	ASSERT_EQ(jary_compile_file(J, STORAGE_JARY_PATH, NULL), JARY_OK);
+
+	ASSERT_EQ(jary_rule_stream(J, "no_such_rule", row_callback, &rows),
+		  JARY_ERR_NOTEXIST);
+	ASSERT_EQ(jary_rule_stream(J, "seen_root", row_callback, &rows),
+		  JARY_OK);
+	ASSERT_EQ(jary_rule_stream(J, "seen_root", final_callback, &once),
+		  JARY_OK);
+	ASSERT_EQ(jary_rule_clbk(J, "seen_root", count_callback, &count),
+		  JARY_OK);
+
+	for (int i = 0; i < 3; ++i) {
+		ASSERT_EQ(jary_event(J, "user", &ev), JARY_OK);
+		ASSERT_EQ(jary_field_str(J, ev, "name", "root"), JARY_OK);
+	}
+
+	ASSERT_EQ(jary_event(J, "user", &ev), JARY_OK);
+	ASSERT_EQ(jary_field_str(J, ev, "name", "guest"), JARY_OK);
+
+	ASSERT_EQ(jary_execute(J), JARY_OK);
+
+	// one call per row, the rule callback still sees every output
+	ASSERT_EQ(rows, 3);
+	ASSERT_EQ(once, 1);
+	ASSERT_EQ(count, 3);
+
+	ASSERT_EQ(jary_close(J), JARY_OK);
+}
+
+struct batch_cb_data {
+	unsigned int sizes[4];
+	unsigned int calls;
+};
+
+static int batch_callback(void *data, const struct jyBatch *batch)
+{
+	auto		    view = (batch_cb_data *) data;
+	unsigned int	    rows = 0;
+	const char *const  *names;
+	const unsigned int *lens;
+	const long	   *nums;
+
+	jary_batch_len(batch, &rows);
+
+	if (jary_batch_str(batch, 0, &names, &lens) != JARY_OK)
+		return JARY_INT_CRASH;
+
+	if (jary_batch_long(batch, 0, &nums) != JARY_ERR_NOTEXIST)
+		return JARY_INT_CRASH;
+
+	if (jary_batch_str(batch, 1, &names, &lens) != JARY_ERR_NOTEXIST)
+		return JARY_INT_CRASH;
+
+	for (unsigned int i = 0; i < rows; ++i)
+		if (lens[i] != 4 || strcmp(names[i], "root") != 0)
+			return JARY_INT_CRASH;
+
+	if (view->calls < 4)
+		view->sizes[view->calls] = rows;
+
+	view->calls += 1;
+
+	return JARY_OK;
+}
+
+TEST(JaryModuleTest, Batch)
+{
+	struct jary  *J;
+	unsigned int  ev;
+	batch_cb_data data = {};
+
+	ASSERT_EQ(jary_open(&J), JARY_OK);
+	ASSERT_EQ(jary_compile_file(J, STORAGE_JARY_PATH, NULL), JARY_OK);
+
+	ASSERT_EQ(jary_rule_batch_clbk(J, "no_such_rule", 2, batch_callback,
+				       &data),
+		  JARY_ERR_NOTEXIST);
+	ASSERT_EQ(jary_rule_batch_clbk(J, "seen_root", 0, batch_callback,
+				       &data),
+		  JARY_ERROR);
+	ASSERT_EQ(jary_rule_batch_clbk(J, "seen_root", 2, batch_callback,
+				       &data),
+		  JARY_OK);
+
+	for (int i = 0; i < 3; ++i) {
+		ASSERT_EQ(jary_event(J, "user", &ev), JARY_OK);
+		ASSERT_EQ(jary_field_str(J, ev, "name", "root"), JARY_OK);
+	}
+
+	ASSERT_EQ(jary_event(J, "user", &ev), JARY_OK);
+	ASSERT_EQ(jary_field_str(J, ev, "name", "guest"), JARY_OK);
+
+	ASSERT_EQ(jary_execute(J), JARY_OK);
+
+	// a full batch, then the rest once the execution ends
+	ASSERT_EQ(data.calls, 2);
+	ASSERT_EQ(data.sizes[0], 2);
+	ASSERT_EQ(data.sizes[1], 1);
+
+	ASSERT_EQ(jary_close(J), JARY_OK);
+}
+
+TEST(JaryModuleTest, Wildcard)
+{
+	struct jary *J;
+	unsigned int ev;
+	unsigned int rows = 0;
+	unsigned int all  = 0;
+
+	ASSERT_EQ(jary_open(&J), JARY_OK);
+	ASSERT_EQ(jary_compile_file(J, STORAGE_JARY_PATH, NULL), JARY_OK);
+
+	ASSERT_EQ(jary_rule_clbk(J, "auth_*", count_callback, &all),
+		  JARY_ERR_NOTEXIST);
+	ASSERT_EQ(jary_rule_clbk(J, "seen", count_callback, &all),
+		  JARY_ERR_NOTEXIST);
+	ASSERT_EQ(jary_rule_clbk(J, "*", count_callback, &all), JARY_OK);
+	ASSERT_EQ(jary_rule_stream(J, "seen_*", row_callback, &rows),
+		  JARY_OK);
+
+	for (int i = 0; i < 2; ++i) {
+		ASSERT_EQ(jary_event(J, "user", &ev), JARY_OK);
+		ASSERT_EQ(jary_field_str(J, ev, "name", "root"), JARY_OK);
+	}
+
+	ASSERT_EQ(jary_execute(J), JARY_OK);
+
+	ASSERT_EQ(all, 2);
+	ASSERT_EQ(rows, 2);
+
+	ASSERT_EQ(jary_close(J), JARY_OK);
+}
+
+TEST(JaryModuleTest, Unclbk)
+{
+	struct jary  *J;
+	unsigned int  ev;
+	unsigned int  count = 0;
+	unsigned int  kept  = 0;
+	batch_cb_data data  = {};
+
+	ASSERT_EQ(jary_open(&J), JARY_OK);
+	ASSERT_EQ(jary_compile_file(J, STORAGE_JARY_PATH, NULL), JARY_OK);
+
+	ASSERT_EQ(jary_rule_unclbk(J, "seen_root", count_callback, &count),
+		  JARY_ERR_NOTEXIST);
+
+	ASSERT_EQ(jary_rule_clbk(J, "seen_root", count_callback, &count),
+		  JARY_OK);
+	ASSERT_EQ(jary_rule_clbk(J, "seen_root", count_callback, &kept),
+		  JARY_OK);
+	ASSERT_EQ(jary_rule_batch_clbk(J, "seen_root", 2, batch_callback,
+				       &data),
+		  JARY_OK);
+
+	ASSERT_EQ(jary_rule_unclbk(J, "seen_*", count_callback, &count),
+		  JARY_OK);
+	ASSERT_EQ(jary_rule_unclbk(J, "seen_root", count_callback, &count),
+		  JARY_ERR_NOTEXIST);
+	ASSERT_EQ(jary_rule_batch_unclbk(J, "seen_root", batch_callback,
+					 &data),
+		  JARY_OK);
+
+	ASSERT_EQ(jary_event(J, "user", &ev), JARY_OK);
+	ASSERT_EQ(jary_field_str(J, ev, "name", "root"), JARY_OK);
+	ASSERT_EQ(jary_execute(J), JARY_OK);
+
+	// only the callback left behind is called
+	ASSERT_EQ(count, 0);
+	ASSERT_EQ(kept, 1);
+	ASSERT_EQ(data.calls, 0);
+
+	// without any subscriber the rule is not run at all
+	struct jyStats stats;
+	unsigned long  runs;
+
+	ASSERT_EQ(jary_stats(J, &stats), JARY_OK);
+	runs = stats.rules[0].runs;
+
+	ASSERT_EQ(jary_rule_unclbk(J, "*", count_callback, &kept), JARY_OK);
+	ASSERT_EQ(jary_execute(J), JARY_OK);
+	ASSERT_EQ(jary_stats(J, &stats), JARY_OK);
+	ASSERT_EQ(stats.rules[0].runs, runs);
+
+	// freed slots are taken again, the counters never wrap
+	for (int i = 0; i < 70000; ++i) {
+		ASSERT_EQ(jary_rule_clbk(J, "seen_*", count_callback, &count),
+			  JARY_OK);
+		ASSERT_EQ(jary_rule_unclbk(J, "seen_*", count_callback,
+					   &count),
+			  JARY_OK);
+		ASSERT_EQ(jary_rule_batch_clbk(J, "seen_root", 2,
+					       batch_callback, &data),
+			  JARY_OK);
+		ASSERT_EQ(jary_rule_batch_unclbk(J, "seen_root",
+						 batch_callback, &data),
+			  JARY_OK);
+	}
+
+	ASSERT_EQ(jary_rule_clbk(J, "seen_root", count_callback, &count),
+		  JARY_OK);
+	ASSERT_EQ(jary_execute(J), JARY_OK);
+	ASSERT_EQ(count, 1);
+
+	ASSERT_EQ(jary_close(J), JARY_OK);
+}
+
+TEST(JaryModuleTest, Sink)
+{
+	struct jary *J;
+	unsigned int ev;
+	int	     fds[2];
+	char	     buf[256] = { 0 };
+
+	ASSERT_EQ(pipe(fds), 0);
+
+	ASSERT_EQ(jary_open(&J), JARY_OK);
+	ASSERT_EQ(jary_compile_file(J, STORAGE_JARY_PATH, NULL), JARY_OK);
+
+	ASSERT_EQ(jary_rule_sink(J, "no_such_rule", fds[1], JARY_SINK_NDJSON),
+		  JARY_ERR_NOTEXIST);
+	ASSERT_EQ(jary_rule_sink(J, "seen_root", fds[1], 0), JARY_ERROR);
+	ASSERT_EQ(jary_rule_sink(J, "seen_root", fds[1],
+				 JARY_SINK_NDJSON | JARY_SINK_RULE),
+		  JARY_OK);
+	ASSERT_EQ(jary_rule_sink(J, "seen_*", fds[1],
+				 JARY_SINK_NDJSON | JARY_SINK_TIME),
+		  JARY_OK);
+
+	ASSERT_EQ(jary_event(J, "user", &ev), JARY_OK);
+	ASSERT_EQ(jary_field_str(J, ev, "name", "root"), JARY_OK);
+	ASSERT_EQ(jary_execute(J), JARY_OK);
+
+	ASSERT_EQ(jary_close(J), JARY_OK);
+	close(fds[1]);
+
+	ssize_t sz = read(fds[0], buf, sizeof(buf) - 1);
+	close(fds[0]);
+
+	ASSERT_GT(sz, 0);
+
+	const char *line = "{\"rule\":\"seen_root\","
+			   "\"output\":[\"root\"]}\n";
+	ASSERT_EQ(strncmp(buf, line, strlen(line)), 0);
+
+	const char *next = buf + strlen(line);
+	ASSERT_EQ(strncmp(next, "{\"time\":", 8), 0);
+	ASSERT_NE(strstr(next, ",\"output\":[\"root\"]}\n"), nullptr);
+}
+
+static int poll_callback(void *data, const char *rule,
+			 const struct jyOutput *output)
+{
+	const char *name = NULL;
+
+	if (strcmp(rule, "seen_root") != 0)
+		return JARY_INT_CRASH;
+
+	if (jary_output_str(output, 0, &name) != JARY_OK)
+		return JARY_INT_CRASH;
+
+	if (strcmp(name, "root") == 0)
+		*(unsigned int *) data += 1;
+
+	return JARY_OK;
+}
+
+TEST(JaryModuleTest, Ring)
+{
+	struct jary  *J;
+	unsigned int  ev;
+	unsigned int  seen   = 0;
+	unsigned int  polled = 0;
+	unsigned long dropped;
+
+	ASSERT_EQ(jary_open(&J), JARY_OK);
+	ASSERT_EQ(jary_compile_file(J, STORAGE_JARY_PATH, NULL), JARY_OK);
+
+	ASSERT_EQ(jary_rule_ring(J, "seen_root"), JARY_ERROR);
+	ASSERT_EQ(jary_poll_matches(J, 8, poll_callback, &seen, &polled),
+		  JARY_ERROR);
+
+	ASSERT_EQ(jary_ring(J, 2, 256), JARY_OK);
+	ASSERT_EQ(jary_ring(J, 2, 256), JARY_ERROR);
+	ASSERT_EQ(jary_rule_ring(J, "no_such_rule"), JARY_ERR_NOTEXIST);
+	ASSERT_EQ(jary_rule_ring(J, "seen_root"), JARY_OK);
+
+	for (int i = 0; i < 3; ++i) {
+		ASSERT_EQ(jary_event(J, "user", &ev), JARY_OK);
+		ASSERT_EQ(jary_field_str(J, ev, "name", "root"), JARY_OK);
+	}
+
+	ASSERT_EQ(jary_execute(J), JARY_OK);
+
+	// the ring holds two rows, the third one is dropped
+	jary_ring_overflow(J, &dropped);
+	ASSERT_EQ(dropped, 1);
+
+	ASSERT_EQ(jary_poll_matches(J, 8, poll_callback, &seen, &polled),
+		  JARY_OK);
+	ASSERT_EQ(polled, 2);
+	ASSERT_EQ(seen, 2);
+
+	ASSERT_EQ(jary_poll_matches(J, 8, poll_callback, &seen, &polled),
+		  JARY_OK);
+	ASSERT_EQ(polled, 0);
+
+	ASSERT_EQ(jary_close(J), JARY_OK);
+}
+
+TEST(JaryModuleTest, Suppress)
+{
+	struct jary *J;
+	unsigned int ev;
+	unsigned int count = 0;
+	unsigned int rows  = 0;
+
+	ASSERT_EQ(jary_open(&J), JARY_OK);
+	ASSERT_EQ(jary_compile_file(J, SUPPRESS_JARY_PATH, NULL), JARY_OK);
+
+	ASSERT_EQ(jary_rule_clbk(J, "seen_user", count_callback, &count),
+		  JARY_OK);
+	ASSERT_EQ(jary_rule_stream(J, "seen_user", count_callback, &rows),
+		  JARY_OK);
+
+	const char *names[] = { "root", "guest", "root" };
+
+	for (const char *name : names) {
+		ASSERT_EQ(jary_event(J, "user", &ev), JARY_OK);
+		ASSERT_EQ(jary_field_str(J, ev, "name", name), JARY_OK);
+	}
+
+	// the second root is dropped before any callback
+	ASSERT_EQ(jary_execute(J), JARY_OK);
+	ASSERT_EQ(count, 2);
+	ASSERT_EQ(rows, 2);
+
+	// the rows matched again are still within the window
+	ASSERT_EQ(jary_event(J, "user", &ev), JARY_OK);
+	ASSERT_EQ(jary_field_str(J, ev, "name", "admin"), JARY_OK);
+	ASSERT_EQ(jary_execute(J), JARY_OK);
+	ASSERT_EQ(count, 3);
+	ASSERT_EQ(rows, 3);
+
+	ASSERT_EQ(jary_close(J), JARY_OK);
+}
+
+TEST(JaryModuleTest, Limit)
+{
+	struct jary *J;
+	unsigned int ev;
+	unsigned int count = 0;
+	unsigned int rows  = 0;
+
+	ASSERT_EQ(jary_open(&J), JARY_OK);
+	ASSERT_EQ(jary_compile_file(J, STORAGE_JARY_PATH, NULL), JARY_OK);
+
+	ASSERT_EQ(jary_rule_limit(J, "no_such_rule", 0, 2, 0),
+		  JARY_ERR_NOTEXIST);
+	ASSERT_EQ(jary_rule_limit(J, "seen_*", 0, 2, 60000), JARY_OK);
+	ASSERT_EQ(jary_rule_clbk(J, "seen_root", count_callback, &count),
+		  JARY_OK);
+	ASSERT_EQ(jary_rule_stream(J, "seen_root", count_callback, &rows),
+		  JARY_OK);
+
+	for (int i = 0; i < 3; ++i) {
+		ASSERT_EQ(jary_event(J, "user", &ev), JARY_OK);
+		ASSERT_EQ(jary_field_str(J, ev, "name", "root"), JARY_OK);
+	}
+
+	// the third row is over budget, only the streamed rows are out
+	ASSERT_EQ(jary_execute(J), JARY_ERR_LIMIT);
+	ASSERT_EQ(rows, 2);
+	ASSERT_EQ(count, 0);
+
+	// an interrupt outside of an execution is forgotten
+	jary_interrupt(J);
+
+	ASSERT_EQ(jary_rule_limit(J, "seen_root", 0, 0, 0), JARY_OK);
+	ASSERT_EQ(jary_execute(J), JARY_OK);
+	ASSERT_EQ(rows, 5);
+	ASSERT_EQ(count, 3);
+
+	ASSERT_EQ(jary_close(J), JARY_OK);
+}
+
+struct interrupt_data {
+	struct jary *J;
+	unsigned int rows;
+};
+
+// interrupts the execution at the first row, queueing 3 events that the
+// interrupted execution never inserts
+static int interrupt_callback(void *data, const struct jyOutput *output)
+{
+	struct interrupt_data *d = (struct interrupt_data *) data;
+	unsigned int	       ev;
+
+	(void) output;
+
+	d->rows += 1;
+
+	if (d->rows > 1)
+		return JARY_OK;
+
+	for (int i = 0; i < 3; ++i) {
+		if (jary_event(d->J, "user", &ev) != JARY_OK)
+			return JARY_INT_CRASH;
+
+		if (jary_field_str(d->J, ev, "name", "root") != JARY_OK)
+			return JARY_INT_CRASH;
+	}
+
+	jary_interrupt(d->J);
+
+	return JARY_OK;
+}
+
+TEST(JaryModuleTest, Interrupt)
+{
+	struct jary	     *J;
+	unsigned int	      ev;
+	struct interrupt_data data = { .rows = 0 };
+
+	ASSERT_EQ(jary_open(&J), JARY_OK);
+	ASSERT_EQ(jary_compile_file(J, STORAGE_JARY_PATH, NULL), JARY_OK);
+	ASSERT_EQ(jary_rule_stream(J, "seen_root", interrupt_callback, &data),
+		  JARY_OK);
+
+	data.J = J;
+
+	for (int i = 0; i < 500; ++i) {
+		ASSERT_EQ(jary_event(J, "user", &ev), JARY_OK);
+		ASSERT_EQ(jary_field_str(J, ev, "name", "root"), JARY_OK);
+	}
+
+	// the query stops right at the row that interrupted it
+	ASSERT_EQ(jary_execute(J), JARY_ERR_INTR);
+	ASSERT_EQ(data.rows, 1);
+
+	// the events left queued are inserted by the next call
+	ASSERT_EQ(jary_execute(J), JARY_OK);
+	ASSERT_EQ(data.rows, 1 + 503);
+
+	ASSERT_EQ(jary_close(J), JARY_OK);
+}
+
+TEST(JaryModuleTest, Stats)
+{
+	struct jary   *J;
+	unsigned int   ev;
+	unsigned int   count = 0;
+	struct jyStats stats;
+
+	ASSERT_EQ(jary_open(&J), JARY_OK);
+	ASSERT_EQ(jary_stats(J, &stats), JARY_ERR_NOTEXIST);
+	ASSERT_EQ(jary_compile_file(J, STORAGE_JARY_PATH, NULL), JARY_OK);
+	ASSERT_EQ(jary_rule_clbk(J, "seen_root", count_callback, &count),
+		  JARY_OK);
+
+	jary_profile(J, 1);
+
+	const char *names[] = { "root", "guest", "root" };
+
+	for (const char *name : names) {
+		ASSERT_EQ(jary_event(J, "user", &ev), JARY_OK);
+		ASSERT_EQ(jary_field_str(J, ev, "name", name), JARY_OK);
+	}
+
+	ASSERT_EQ(jary_execute(J), JARY_OK);
+	ASSERT_EQ(jary_stats(J, &stats), JARY_OK);
+
+	ASSERT_EQ(stats.executions, 1);
+	ASSERT_EQ(stats.ingressz, 1);
+	ASSERT_STREQ(stats.ingress[0].name, "user");
+	ASSERT_EQ(stats.ingress[0].events, 3);
+	ASSERT_EQ(stats.rulesz, 1);
+
+	const struct jyRuleStats *rule = &stats.rules[0];
+
+	ASSERT_STREQ(rule->name, "seen_root");
+	ASSERT_EQ(rule->runs, 1);
+	ASSERT_EQ(rule->rows, 2);
+	ASSERT_EQ(rule->matches, 2);
+	ASSERT_EQ(rule->limits, 0);
+	ASSERT_GT(rule->step_ns, 0);
+
+	// counters keep going without the clock
+	jary_profile(J, 0);
+
+	ASSERT_EQ(jary_execute(J), JARY_OK);
+	ASSERT_EQ(jary_stats(J, &stats), JARY_OK);
+	ASSERT_EQ(stats.executions, 2);
+	ASSERT_EQ(stats.rules[0].runs, 2);
+	ASSERT_EQ(stats.rules[0].matches, 4);
+
+	ASSERT_EQ(jary_close(J), JARY_OK);
+}
+
+TEST(JaryModuleTest, Latency)
+{
+	struct jary	*J;
+	unsigned int	 ev;
+	unsigned int	 count = 0;
+	struct jyLatency lat;
+
+	ASSERT_EQ(jary_open(&J), JARY_OK);
+	ASSERT_EQ(jary_latency(J, 1), JARY_ERR_NOTEXIST);
+	ASSERT_EQ(jary_compile_file(J, STORAGE_JARY_PATH, NULL), JARY_OK);
+	ASSERT_EQ(jary_rule_clbk(J, "seen_root", count_callback, &count),
+		  JARY_OK);
+
+	// queued before recording starts, it has no enqueue time
+	ASSERT_EQ(jary_event(J, "user", &ev), JARY_OK);
+	ASSERT_EQ(jary_field_str(J, ev, "name", "root"), JARY_OK);
+
+	ASSERT_EQ(jary_latency(J, 1), JARY_OK);
+
+	for (int i = 0; i < 2; ++i) {
+		ASSERT_EQ(jary_event(J, "user", &ev), JARY_OK);
+		ASSERT_EQ(jary_field_str(J, ev, "name", "root"), JARY_OK);
+	}
+
+	ASSERT_EQ(jary_execute(J), JARY_OK);
+	ASSERT_EQ(count, 3);
+
+	ASSERT_EQ(jary_latency_histogram(J, "no_such_rule", &lat),
+		  JARY_ERR_NOTEXIST);
+	ASSERT_EQ(jary_latency_histogram(J, "seen_*", &lat), JARY_OK);
+	ASSERT_EQ(lat.count, 2);
+	ASSERT_GT(lat.p50, 0);
+	ASSERT_LE(lat.p50, lat.p99);
+	ASSERT_LE(lat.p99, lat.p999);
+	ASSERT_LE(lat.p999, lat.max);
+
+	// the rule matches the same rows again, they were recorded already
+	ASSERT_EQ(jary_execute(J), JARY_OK);
+	ASSERT_EQ(count, 6);
+	ASSERT_EQ(jary_latency_histogram(J, "seen_*", &lat), JARY_OK);
+	ASSERT_EQ(lat.count, 2);
+
+	ASSERT_EQ(jary_event(J, "user", &ev), JARY_OK);
+	ASSERT_EQ(jary_field_str(J, ev, "name", "root"), JARY_OK);
+	ASSERT_EQ(jary_execute(J), JARY_OK);
+	ASSERT_EQ(jary_latency_histogram(J, "seen_*", &lat), JARY_OK);
+	ASSERT_EQ(lat.count, 3);
+
+	ASSERT_EQ(jary_close(J), JARY_OK);
+}
+
+TEST(JaryModuleTest, RulePlan)
+{
+	struct jary *J;
+	char	    *text = NULL;
+
+	ASSERT_EQ(jary_open(&J), JARY_OK);
+	ASSERT_EQ(jary_modulepath(J, MODULE_DIR), JARY_OK);
+	ASSERT_EQ(jary_compile_file(J, SIMPLE_JARY_PATH, NULL), JARY_OK);
+
+	ASSERT_EQ(jary_rule_plan(J, "no_such_rule", &text), JARY_ERR_NOTEXIST);
+	ASSERT_EQ(jary_rule_plan(J, "auth_brute_force", &text), JARY_OK);
+	ASSERT_NE(text, nullptr);
+
+	// no index on the user table, so the plan must flag it
+	ASSERT_NE(strstr(text, "SELECT"), nullptr);
+	ASSERT_NE(strstr(text, "QUERY PLAN"), nullptr);
+	ASSERT_NE(strstr(text, "full scan"), nullptr);
+
+	jary_free(text);
+
+	ASSERT_EQ(jary_close(J), JARY_OK);
+}
+
+TEST(JaryModuleTest, Projection)
+{
+	struct jary *J;
+	char	    *text = NULL;
+
+	ASSERT_EQ(jary_open(&J), JARY_OK);
+	ASSERT_EQ(jary_modulepath(J, MODULE_DIR), JARY_OK);
+	ASSERT_EQ(jary_compile_file(J, SIMPLE_JARY_PATH, NULL), JARY_OK);
+
+	// the action only takes a literal, no field is decoded
+	ASSERT_EQ(jary_rule_plan(J, "count_root_fail_login", &text), JARY_OK);
+	ASSERT_NE(strstr(text, "SELECT 1 FROM"), nullptr);
+
+	jary_free(text);
+
+	// activity is only matched on, name is read by the condition
+	ASSERT_EQ(jary_rule_plan(J, "auth_brute_force", &text), JARY_OK);
+	ASSERT_NE(strstr(text, "SELECT user.name FROM"), nullptr);
+
+	jary_free(text);
+
+	ASSERT_EQ(jary_close(J), JARY_OK);
+}
+
+TEST(JaryModuleTest, Native)
+{
+	const char   src[] = "jary_native_test.c";
+	const char   lib[] = "./jary_native_test.so";
+	struct jary *J;
+	unsigned int ev;
+	char	    *text = NULL;
+
+	ASSERT_EQ(jary_open(&J), JARY_OK);
+	ASSERT_EQ(jary_modulepath(J, MODULE_DIR), JARY_OK);
+	ASSERT_EQ(jary_compile_file(J, SIMPLE_JARY_PATH, NULL), JARY_OK);
+	ASSERT_EQ(jary_native_source(J, &text), JARY_OK);
+
+	FILE *file = fopen(src, "w");
+	ASSERT_NE(file, nullptr);
+	fputs(text, file);
+	fclose(file);
+	jary_free(text);
+
+	std::string cc = std::string("cc -shared -fPIC -O2 -I") + JARY_INCLUDE_DIR
+		       + " -o " + lib + " " + src;
+
+	if (system(cc.c_str()) != 0) {
+		jary_close(J);
+		GTEST_SKIP() << "no C compiler to build native rules";
+	}
+
+	ASSERT_EQ(jary_native(J, lib), JARY_OK);
+
+	for (int i = 0; i < 10; ++i) {
+		ASSERT_EQ(jary_event(J, "user", &ev), JARY_OK);
+		ASSERT_EQ(jary_field_str(J, ev, "name", "root"), JARY_OK);
+		ASSERT_EQ(jary_field_str(J, ev, "activity", "failed login"),
+			  JARY_OK);
+	}
+
+	struct simple_cb_data data = { .msg = NULL };
+
+	ASSERT_EQ(jary_rule_clbk(J, "auth_brute_force", callback, &data),
+		  JARY_OK);
+	ASSERT_EQ(jary_execute(J), JARY_OK);
+
+	ASSERT_STREQ(data.msg, "must've been the wind");
+	ASSERT_EQ(data.count, 10);
+
+	free(data.msg);
+
+	ASSERT_EQ(jary_close(J), JARY_OK);
+
+	// built from other rules, the bytecode must stay in charge
+	ASSERT_EQ(jary_open(&J), JARY_OK);
+	ASSERT_EQ(jary_compile_file(J, STORAGE_JARY_PATH, NULL), JARY_OK);
+	ASSERT_EQ(jary_native(J, lib), JARY_ERR_MISMATCH);
+	ASSERT_EQ(jary_close(J), JARY_OK);
+
+	remove(src);
+	remove(lib);
+}
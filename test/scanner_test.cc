@@ -126,7 +126,7 @@ TEST(ScannerTest, ScanKeyword)
 		{ "then", TKN_RESERVED },   { "range", TKN_RESERVED },
 		{ "gt", TKN_RESERVED },	    { "lt", TKN_RESERVED },
 		{ "gte", TKN_RESERVED },    { "lte", TKN_RESERVED },
-		{ "in", TKN_RESERVED },
+		{ "in", TKN_RESERVED },	    { "suppress", TKN_SUPPRESS },
 	};
 
 	int keywordsz = sizeof(keyword) / sizeof(keyword[0]);
@@ -37,6 +37,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "token.h"
 
 #include "jary/defs.h"
+#include "jary/jary.h"
 #include "jary/memory.h"
 #include "jary/types.h"
 
@@ -71,6 +72,8 @@ static const char *tkn2string(enum jy_tkn type)
 		return "TKN_RESERVED";
 	case TKN_OUTPUT:
 		return "TKN_OUTPUT";
+	case TKN_SUPPRESS:
+		return "TKN_SUPPRESS";
 	case TKN_REGEX:
 		return "TKN_REGEX";
 	case TKN_COMMENT:
@@ -199,6 +202,8 @@ static const char *ast2string(enum jy_ast type)
 		return "REGEX";
 	case AST_OUTPUT_SECT:
 		return "OUTPUT_SECT";
+	case AST_SUPPRESS_SECT:
+		return "SUPPRESS_SECT";
 	case AST_NONE:
 		return "NONE";
 	case AST_WITHIN:
@@ -379,14 +384,30 @@ static const char *codestring(enum jy_opcode code)
 		return "OP_JMPT";
 	case JY_OP_CALL:
 		return "OP_CALL";
+	case JY_OP_CALLV:
+		return "OP_CALLV";
 	case JY_OP_JOIN:
 		return "OP_JOIN";
 	case JY_OP_EQUAL:
 		return "OP_EQUAL";
-	case JY_OP_CONCAT:
-		return "OP_CONCAT";
+	case JY_OP_CONCATN:
+		return "OP_CONCATN";
 	case JY_OP_QUERY:
 		return "OP_QUERY";
+	case JY_OP_CMPSTR_FK:
+		return "OP_CMPSTR_FK";
+	case JY_OP_CMP_FK:
+		return "OP_CMP_FK";
+	case JY_OP_LT_FK:
+		return "OP_LT_FK";
+	case JY_OP_GT_FK:
+		return "OP_GT_FK";
+	case JY_OP_DUP:
+		return "OP_DUP";
+	case JY_OP_SETR:
+		return "OP_SETR";
+	case JY_OP_GETR:
+		return "OP_GETR";
 	case JY_OP_END:
 		return "OP_END";
 	}
@@ -633,6 +654,9 @@ static inline void print_value(enum jy_ktype type, const union jy_value value)
 	case JY_K_ULONG:
 		printf("%ld", value.u64);
 		return;
+	case JY_K_RULE:
+		printf("%lu", value.ofs);
+		return;
 	case JY_K_TIME:
 		printf("%d ", value.timeofs.offset);
 
@@ -805,7 +829,6 @@ static uint32_t print_chunk(uint8_t *codes, uint32_t pc, int indent)
 		case JY_OP_LT:
 		case JY_OP_GT:
 		case JY_OP_ADD:
-		case JY_OP_CONCAT:
 		case JY_OP_SUB:
 		case JY_OP_MUL:
 		case JY_OP_DIV:
@@ -828,11 +851,23 @@ static uint32_t print_chunk(uint8_t *codes, uint32_t pc, int indent)
 			pc += 3;
 			break;
 		}
-		case JY_OP_CALL: {
+		case JY_OP_DUP:
+		case JY_OP_SETR:
+		case JY_OP_GETR:
+		case JY_OP_CALL:
+		case JY_OP_CALLV:
+		case JY_OP_CONCATN: {
 			printf(" %u", arg.u8[0]);
 			pc += 2;
 			break;
 		}
+		case JY_OP_CMPSTR_FK:
+		case JY_OP_CMP_FK:
+		case JY_OP_LT_FK:
+		case JY_OP_GT_FK:
+			printf(" %d %d", arg.u16[0], arg.u16[1]);
+			pc += 5;
+			break;
 		}
 
 		printf("\n");
@@ -989,6 +1024,16 @@ static void run_file(const char *path, const char *dirpath)
 	if (jay.fcodesz)
 		printf("\n");
 
+	printf("PROLOGUE CHUNKS"
+	       "\n"
+	       "__________________\n\n");
+
+	for (unsigned int i = 0; i < jay.pcodesz;)
+		i = print_chunk(jay.pcodes, i, 0);
+
+	if (jay.pcodesz)
+		printf("\n");
+
 	printf("ENTRY CHUNK"
 	       "\n"
 	       "__________________\n\n");
@@ -998,6 +1043,20 @@ static void run_file(const char *path, const char *dirpath)
 
 	printf("\n");
 
+	printf("OPTIMIZER"
+	       "\n"
+	       "__________________\n\n");
+
+	printf("Folded Expressions : %u\n", jay.foldsz);
+	printf("Shared Expressions : %u\n", jay.sharesz);
+	printf("Hoisted Expressions: %u\n", jay.hoistsz);
+
+	for (uint32_t i = 0; i < jay.deadsz; ++i)
+		printf("Removed Rule       : %s (condition is never true)\n",
+		       jay.names->keys[jay.deadnids[i]]);
+
+	printf("\n");
+
 	if (errs.size) {
 		/*int sz	= print_errors(&errs, &tkns, path);*/
 		int sz = prerrors(0, NULL, &errs, &tkns, path);
@@ -1012,6 +1071,253 @@ static void run_file(const char *path, const char *dirpath)
 	sc_free(&sc);
 }
 
+static void plan_file(const char *path, const char *dirpath)
+{
+	struct jary   *J      = NULL;
+	char	      *errmsg = NULL;
+	struct jyStats stats;
+
+	char dirname[] = "/modules/";
+	char mdir[strlen(dirpath) + sizeof(dirname)];
+
+	strcpy(mdir, dirpath);
+	strcat(mdir, dirname);
+
+	if (jary_open(&J) != JARY_OK) {
+		fprintf(stderr, "%s\n", jary_errmsg(J));
+		goto FINISH;
+	}
+
+	jary_modulepath(J, mdir);
+
+	if (jary_compile_file(J, path, &errmsg) != JARY_OK) {
+		fprintf(stderr, "%s\n", errmsg ? errmsg : jary_errmsg(J));
+		goto FINISH;
+	}
+
+	// the rule names come with the stats of the compiled code
+	jary_stats(J, &stats);
+
+	for (uint32_t i = 0; i < stats.rulesz; ++i) {
+		const char *rule = stats.rules[i].name;
+		char	   *text = NULL;
+
+		printf("RULE %s"
+		       "\n"
+		       "__________________\n\n",
+		       rule);
+
+		if (jary_rule_plan(J, rule, &text) != JARY_OK) {
+			printf("%s\n\n", jary_errmsg(J));
+			continue;
+		}
+
+		printf("%s\n", text);
+		jary_free(text);
+	}
+
+FINISH:
+	jary_free(errmsg);
+
+	if (J != NULL)
+		jary_close(J);
+}
+
+static void emit_file(const char *path, const char *dirpath)
+{
+	struct jary *J	    = NULL;
+	char	    *errmsg = NULL;
+	char	    *text   = NULL;
+
+	char dirname[] = "/modules/";
+	char mdir[strlen(dirpath) + sizeof(dirname)];
+
+	strcpy(mdir, dirpath);
+	strcat(mdir, dirname);
+
+	if (jary_open(&J) != JARY_OK) {
+		fprintf(stderr, "%s\n", jary_errmsg(J));
+		goto FINISH;
+	}
+
+	jary_modulepath(J, mdir);
+
+	if (jary_compile_file(J, path, &errmsg) != JARY_OK) {
+		fprintf(stderr, "%s\n", errmsg ? errmsg : jary_errmsg(J));
+		goto FINISH;
+	}
+
+	if (jary_native_source(J, &text) != JARY_OK) {
+		fprintf(stderr, "%s\n", jary_errmsg(J));
+		goto FINISH;
+	}
+
+	fputs(text, stdout);
+
+FINISH:
+	jary_free(text);
+	jary_free(errmsg);
+
+	if (J != NULL)
+		jary_close(J);
+}
+
+static int noop_clbk(void *data, const struct jyOutput *output)
+{
+	(void) data;
+	(void) output;
+
+	return JARY_OK;
+}
+
+static int by_time(const void *a, const void *b)
+{
+	const struct jyRuleStats *r1 = *(const struct jyRuleStats **) a;
+	const struct jyRuleStats *r2 = *(const struct jyRuleStats **) b;
+
+	unsigned long t1 = r1->prepare_ns + r1->step_ns + r1->interpret_ns
+			 + r1->callback_ns;
+	unsigned long t2 = r2->prepare_ns + r2->step_ns + r2->interpret_ns
+			 + r2->callback_ns;
+
+	return (t1 < t2) - (t1 > t2);
+}
+
+// queue one event per line of "ingress field=value ...", a value is
+// either true, false, a number or a string
+static void queue_line(struct jary *J, char *line)
+{
+	const char  *delims = " \t\r\n";
+	char	    *ingress = strtok(line, delims);
+	unsigned int event;
+
+	if (ingress == NULL)
+		return;
+
+	if (jary_event(J, ingress, &event) != JARY_OK) {
+		fprintf(stderr, "%s: %s\n", ingress, jary_errmsg(J));
+		return;
+	}
+
+	for (char *tkn; (tkn = strtok(NULL, delims)) != NULL;) {
+		char *value = strchr(tkn, '=');
+		char *end   = NULL;
+		int   ret;
+
+		if (value == NULL)
+			continue;
+
+		*value++ = '\0';
+
+		long num = strtol(value, &end, 10);
+
+		if (strcmp(value, "true") == 0 || strcmp(value, "false") == 0)
+			ret = jary_field_bool(J, event, tkn, *value == 't');
+		else if (*value != '\0' && *end == '\0')
+			ret = jary_field_long(J, event, tkn, num);
+		else
+			ret = jary_field_str(J, event, tkn, value);
+
+		if (ret != JARY_OK)
+			fprintf(stderr, "%s: %s\n", tkn, jary_errmsg(J));
+	}
+}
+
+static void profile_file(const char *path, const char *dirpath, int top)
+{
+	struct jary		   *J	   = NULL;
+	char			   *errmsg = NULL;
+	const struct jyRuleStats  **rules  = NULL;
+	struct jyStats		    stats;
+	char			    line[4096];
+
+	char dirname[] = "/modules/";
+	char mdir[strlen(dirpath) + sizeof(dirname)];
+
+	strcpy(mdir, dirpath);
+	strcat(mdir, dirname);
+
+	if (jary_open(&J) != JARY_OK) {
+		fprintf(stderr, "%s\n", jary_errmsg(J));
+		goto FINISH;
+	}
+
+	jary_modulepath(J, mdir);
+
+	if (jary_compile_file(J, path, &errmsg) != JARY_OK) {
+		fprintf(stderr, "%s\n", errmsg ? errmsg : jary_errmsg(J));
+		goto FINISH;
+	}
+
+	// rules nobody listens to are skipped, listen to all of them
+	jary_rule_clbk(J, "*", noop_clbk, NULL);
+	jary_profile(J, 1);
+
+	while (fgets(line, sizeof(line), stdin) != NULL) {
+		queue_line(J, line);
+
+		if (jary_execute(J) != JARY_OK)
+			fprintf(stderr, "%s\n", jary_errmsg(J));
+	}
+
+	jary_stats(J, &stats);
+
+	rules = malloc(sizeof(*rules) * (stats.rulesz + 1));
+
+	if (rules == NULL)
+		goto FINISH;
+
+	for (unsigned int i = 0; i < stats.rulesz; ++i)
+		rules[i] = &stats.rules[i];
+
+	qsort(rules, stats.rulesz, sizeof(*rules), by_time);
+
+	printf("EXECUTIONS %lu, INSERT %lu us\n\n",
+	       stats.executions,
+	       stats.insert_ns / 1000);
+
+	for (unsigned int i = 0; i < stats.ingressz; ++i)
+		printf("INGRESS %-24s %10lu events\n",
+		       stats.ingress[i].name,
+		       stats.ingress[i].events);
+
+	printf("\n%-24s %8s %8s %8s %10s %10s %10s %10s %10s %6s\n",
+	       "RULE",
+	       "RUNS",
+	       "ROWS",
+	       "MATCHES",
+	       "OPS",
+	       "PREP us",
+	       "STEP us",
+	       "VM us",
+	       "CLBK us",
+	       "LIMITS");
+
+	for (unsigned int i = 0; i < stats.rulesz && (int) i < top; ++i) {
+		const struct jyRuleStats *r = rules[i];
+
+		printf("%-24s %8lu %8lu %8lu %10lu %10lu %10lu %10lu %10lu "
+		       "%6lu\n",
+		       r->name,
+		       r->runs,
+		       r->rows,
+		       r->matches,
+		       r->ops,
+		       r->prepare_ns / 1000,
+		       r->step_ns / 1000,
+		       r->interpret_ns / 1000,
+		       r->callback_ns / 1000,
+		       r->limits);
+	}
+
+FINISH:
+	free(rules);
+	jary_free(errmsg);
+
+	if (J != NULL)
+		jary_close(J);
+}
+
 int main(int argc, const char **argv)
 {
 	const char *binpath = argv[0];
@@ -1024,10 +1330,20 @@ int main(int argc, const char **argv)
 
 	dirpath[dirsz - 1] = '\0';
 
-	if (argc == 2)
+	if (argc == 3 && strcmp(argv[1], "--plan") == 0)
+		plan_file(argv[2], dirpath);
+	else if (argc == 3 && strcmp(argv[1], "--emit-c") == 0)
+		emit_file(argv[2], dirpath);
+	else if (argc == 3 && strcmp(argv[1], "--profile") == 0)
+		profile_file(argv[2], dirpath, 10);
+	else if (argc == 4 && strcmp(argv[1], "--profile") == 0)
+		profile_file(argv[3], dirpath, atoi(argv[2]));
+	else if (argc == 2)
 		run_file(argv[1], dirpath);
 	else
-		fprintf(stderr, "require file path");
+		fprintf(stderr,
+			"usage: jassy [--plan | --emit-c | --profile [n]] "
+			"<file>");
 
 	return 0;
 }